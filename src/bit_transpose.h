@@ -0,0 +1,34 @@
+#ifndef BIT_TRANSPOSE_H
+#define BIT_TRANSPOSE_H
+
+#include <limits>
+#include <type_traits>
+
+/*
+Transpose a square matrix of bits in place. "rows" holds one row per Word, and
+bit i of rows[j] is column i of row j (least significant bit first, matching
+BoolVoxelVolume's packing). Afterwards, bit i of rows[j] is the old bit j of
+rows[i].
+
+This is the recursive block-swap algorithm from Hacker's Delight 7-3: swap the
+off-diagonal halves of the matrix, then the off-diagonal quarters of each half,
+and so on down to single bits. An NxN matrix takes log2(N) passes of N/2 swaps,
+each swap being a handful of word operations.
+*/
+template<typename Word>
+void TransposeBits(Word (&rows)[std::numeric_limits<Word>::digits]) {
+  static_assert(std::is_unsigned<Word>::value);
+  constexpr int Bits = std::numeric_limits<Word>::digits;
+
+  // "mask" selects the low half of each 2*j bit block
+  Word mask = Word(~Word(0)) >> (Bits / 2);
+  for(int j = Bits / 2; j != 0; j >>= 1, mask ^= Word(mask << j)) {
+    for(int k = 0; k < Bits; k = ((k | j) + 1) & ~j) {
+      Word t = ((rows[k] >> j) ^ rows[k | j]) & mask;
+      rows[k] ^= Word(t << j);
+      rows[k | j] ^= t;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,417 @@
+#include "block_mesh.h"
+
+#include <algorithm>
+#include <cassert>
+#include <unordered_map>
+
+namespace {
+
+// indices in the mesh's normals
+constexpr int x_pos_normal = 0;
+constexpr int x_neg_normal = 1;
+constexpr int y_pos_normal = 2;
+constexpr int y_neg_normal = 3;
+constexpr int z_pos_normal = 4;
+constexpr int z_neg_normal = 5;
+
+void AddNormals(TriMesh *mesh) {
+  mesh->normals.reserve(6);
+  mesh->normals.push_back( UnitX_Vector3f);
+  mesh->normals.push_back(-UnitX_Vector3f);
+  mesh->normals.push_back( UnitY_Vector3f);
+  mesh->normals.push_back(-UnitY_Vector3f);
+  mesh->normals.push_back( UnitZ_Vector3f);
+  mesh->normals.push_back(-UnitZ_Vector3f);
+}
+
+bool SameColor(const Color &a, const Color &b) {
+  return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+} // namespace
+
+BlockMeshBuilder::BlockMeshBuilder(const VoxelVolume &volume, int z_begin) :
+  BlockMeshBuilder(volume, 0, volume.XSize(), 0, volume.YSize(), z_begin)
+{}
+
+BlockMeshBuilder::BlockMeshBuilder(
+  const VoxelVolume &volume,
+  int x_begin, int x_end, int y_begin, int y_end, int z_begin
+) :
+  x_min_(volume.MinBound().x),
+  y_min_(volume.MinBound().y),
+  z_min_(volume.MinBound().z),
+  voxel_x_size_(volume.VoxelXSize()),
+  voxel_y_size_(volume.VoxelYSize()),
+  voxel_z_size_(volume.VoxelZSize()),
+  x_begin_(x_begin),
+  y_begin_(y_begin),
+  verts_x_size_(x_end - x_begin + 1),
+  verts_y_size_(y_end - y_begin + 1),
+  slice_size_(size_t(verts_x_size_) * verts_y_size_),
+  vert_offsets_(std::make_unique<int[]>(2 * slice_size_)),
+  z_begin_(z_begin)
+{
+  mesh_.has_color = true;
+  AddNormals(&mesh_);
+}
+
+void BlockMeshBuilder::AdvanceTo(int z) {
+  assert(z > z_);
+  // keep the top slice of vertices of the voxels at z - 1, the bottom of
+  // those at z, if that's where the last faces were
+  const bool keep_one = (z == z_ + 1);
+  int *forget = vert_offsets_.get() + (keep_one ? (z_ & 1) * slice_size_ : 0);
+  std::fill_n(forget, keep_one ? slice_size_ : 2 * slice_size_, -1);
+  z_ = z;
+}
+
+int BlockMeshBuilder::Vert(int x, int y, int z) {
+  assert(z == z_ || z == z_ + 1);
+  const size_t xy = size_t(y - y_begin_) * verts_x_size_ + (x - x_begin_);
+  int *offset = vert_offsets_.get() + (z & 1) * slice_size_ + xy;
+  if(*offset == -1) {
+    mesh_.verts.push_back(Vector3f {
+      x_min_ + x * voxel_x_size_,
+      y_min_ + y * voxel_y_size_,
+      z_min_ + z * voxel_z_size_
+    });
+    *offset = mesh_.verts.size() - 1;
+    if(z == z_begin_)
+      seam_verts_.emplace_back(*offset, xy);
+  }
+  return *offset;
+}
+
+TriMesh BlockMeshBuilder::Stitch(std::vector<BlockMeshBuilder> *slabs) {
+  std::vector<BlockMeshBuilder> &builders = *slabs;
+  const int n = int(builders.size());
+  if(n == 1)
+    return builders[0].TakeMesh();
+
+  // The vertices a builder shares with the one below are those at its
+  // z_begin_ that the one below also made. The rest are new, in the order
+  // it made them, as a single builder would have: each vertex's index in
+  // the stitched mesh is "new_verts" of the builders below plus its rank
+  // among its own builder's new vertices. A shared vertex, marked here as
+  // -2 - its index in the builder below, takes that vertex's index; -1 marks
+  // a new one.
+  std::vector<std::vector<int>> vert_indices(n);
+  std::vector<size_t> new_verts(n + 1, 0), tris(n + 1, 0);
+  ParallelFor(0, n, [&](int i) {
+    const BlockMeshBuilder &builder = builders[i];
+    std::vector<int> &indices = vert_indices[i];
+    indices.assign(builder.mesh_.verts.size(), -1);
+    size_t shared = 0;
+    if(i > 0) {
+      const BlockMeshBuilder &below_builder = builders[i-1];
+      for(const auto &seam: builder.seam_verts_) {
+        const int below =
+          below_builder.FindVert(seam.second, builder.z_begin_);
+        if(below != -1) {
+          indices[seam.first] = -2 - below;
+          shared++;
+        }
+      }
+    }
+    new_verts[i + 1] = indices.size() - shared;
+    tris[i + 1] = builder.mesh_.tris.size();
+  });
+  for(int i = 0; i < n; i++) {
+    new_verts[i + 1] += new_verts[i];
+    tris[i + 1] += tris[i];
+  }
+
+  TriMesh mesh;
+  mesh.has_color = true;
+  AddNormals(&mesh);
+  mesh.verts.resize(new_verts[n]);
+  // no default constructor to resize with
+  mesh.tris.assign(tris[n], Tri(0, 0, 0));
+
+  ParallelFor(0, n, [&](int i) {
+    const std::vector<Vector3f> &verts = builders[i].mesh_.verts;
+    std::vector<int> &indices = vert_indices[i];
+    int next = int(new_verts[i]);
+    for(size_t v = 0; v < verts.size(); v++) {
+      if(indices[v] == -1) {
+        indices[v] = next;
+        mesh.verts[next++] = verts[v];
+      }
+    }
+  });
+  // the builder below has numbered all of its vertices now
+  ParallelFor(0, n, [&](int i) {
+    std::vector<int> &indices = vert_indices[i];
+    for(const auto &seam: builders[i].seam_verts_) {
+      int &index = indices[seam.first];
+      if(index < 0)
+        index = vert_indices[i-1][-2 - index];
+    }
+    std::vector<Tri> &slab_tris = builders[i].mesh_.tris;
+    Tri *out = mesh.tris.data() + tris[i];
+    for(const Tri &tri: slab_tris) {
+      *out = tri;
+      for(int &vert: out->vert_idxs)
+        vert = indices[vert];
+      out++;
+    }
+    std::vector<Tri>().swap(slab_tris);
+  });
+  return mesh;
+}
+
+void BlockMeshBuilder::AddFaces(int x, int y, int z, int faces, Color color) {
+  if(z != z_)
+    AdvanceTo(z);
+
+  // two triangles, a-b-c and b-d-c, facing along "normal"
+  auto add_quad = [&](int a, int b, int c, int d, int normal) {
+    mesh_.tris.emplace_back(a, b, c, normal, normal, normal, color);
+    mesh_.tris.emplace_back(b, d, c, normal, normal, normal, color);
+  };
+
+  if(faces & XNegFace) {
+    int a = Vert(x, y, z);
+    int b = Vert(x, y, z+1);
+    int c = Vert(x, y+1, z);
+    int d = Vert(x, y+1, z+1);
+    add_quad(a, b, c, d, x_neg_normal);
+  }
+
+  if(faces & XPosFace) {
+    int a = Vert(x+1, y, z);
+    int b = Vert(x+1, y+1, z);
+    int c = Vert(x+1, y, z+1);
+    int d = Vert(x+1, y+1, z+1);
+    add_quad(a, b, c, d, x_pos_normal);
+  }
+
+  if(faces & YNegFace) {
+    int a = Vert(x, y, z);
+    int b = Vert(x+1, y, z);
+    int c = Vert(x, y, z+1);
+    int d = Vert(x+1, y, z+1);
+    add_quad(a, b, c, d, y_neg_normal);
+  }
+
+  if(faces & YPosFace) {
+    int a = Vert(x, y+1, z);
+    int b = Vert(x, y+1, z+1);
+    int c = Vert(x+1, y+1, z);
+    int d = Vert(x+1, y+1, z+1);
+    add_quad(a, b, c, d, y_pos_normal);
+  }
+
+  if(faces & ZNegFace) {
+    int a = Vert(x, y, z);
+    int b = Vert(x, y+1, z);
+    int c = Vert(x+1, y, z);
+    int d = Vert(x+1, y+1, z);
+    add_quad(a, b, c, d, z_neg_normal);
+  }
+
+  if(faces & ZPosFace) {
+    int a = Vert(x, y, z+1);
+    int b = Vert(x+1, y, z+1);
+    int c = Vert(x, y+1, z+1);
+    int d = Vert(x+1, y+1, z+1);
+    add_quad(a, b, c, d, z_pos_normal);
+  }
+}
+
+GreedyBlockMeshBuilder::GreedyBlockMeshBuilder(const VoxelVolume &volume) :
+  volume_(volume)
+{
+  const int sizes[3] = {volume.XSize(), volume.YSize(), volume.ZSize()};
+  // u and v are the faster and slower varying of the other two axes, so each
+  // slice's faces arrive sorted by v, then u
+  const int u_axes[3] = {1, 0, 0}, v_axes[3] = {2, 2, 1};
+  for(int i = 0; i < 6; i++) {
+    Direction &d = directions_[i];
+    d.face = 1 << i;
+    d.axis = i / 2;
+    d.u_axis = u_axes[d.axis];
+    d.v_axis = v_axes[d.axis];
+    d.u_size = sizes[d.u_axis];
+    d.v_size = sizes[d.v_axis];
+    d.slices.resize(sizes[d.axis] + 1);
+  }
+}
+
+void GreedyBlockMeshBuilder::AddFaces(
+  int x, int y, int z, int faces, Color color
+) {
+  const int address[3] = {x, y, z};
+  for(Direction &d: directions_) {
+    if(faces & d.face) {
+      const bool positive = d.face & (XPosFace | YPosFace | ZPosFace);
+      const int slice = address[d.axis] + (positive ? 1 : 0);
+      d.slices[slice].push_back(
+        Face {address[d.u_axis], address[d.v_axis], color});
+    }
+  }
+}
+
+void GreedyBlockMeshBuilder::MergeSlice(
+  int direction, int slice, std::vector<int> *grid
+) {
+  Direction &d = directions_[direction];
+  std::vector<Face> &faces = d.slices[slice];
+  // "grid" holds 1 + the index in "faces" of the face at each u,v, or 0 for
+  // none; it's all 0 again once every face is merged
+  int *cells = grid->data();
+  for(size_t i = 0; i < faces.size(); i++)
+    cells[faces[i].v * d.u_size + faces[i].u] = int(i) + 1;
+
+  auto matches = [&](int u, int v, const Color &color) {
+    const int cell = cells[v * d.u_size + u];
+    return cell && SameColor(faces[cell - 1].color, color);
+  };
+
+  for(const Face &face: faces) {
+    if(!cells[face.v * d.u_size + face.u])
+      continue; // already merged
+    int u1 = face.u + 1;
+    while(u1 < d.u_size && matches(u1, face.v, face.color))
+      u1++;
+    int v1 = face.v + 1;
+    for(; v1 < d.v_size; v1++) {
+      int u = face.u;
+      while(u < u1 && matches(u, v1, face.color))
+        u++;
+      if(u < u1)
+        break;
+    }
+    for(int v = face.v; v < v1; v++) {
+      for(int u = face.u; u < u1; u++)
+        cells[v * d.u_size + u] = 0;
+    }
+    rects_.push_back(
+      Rect {direction, slice, face.u, face.v, u1, v1, face.color});
+  }
+  std::vector<Face>().swap(faces);
+}
+
+TriMesh GreedyBlockMeshBuilder::TakeMesh() {
+  size_t grid_size = 0;
+  for(const Direction &d: directions_)
+    grid_size = std::max(grid_size, size_t(d.u_size) * d.v_size);
+  std::vector<int> grid(grid_size, 0);
+  for(int direction = 0; direction < 6; direction++) {
+    for(int slice = 0; slice < int(directions_[direction].slices.size());
+        slice++)
+      MergeSlice(direction, slice, &grid);
+  }
+
+  const int verts_x_size = volume_.XSize() + 1;
+  const int verts_y_size = volume_.YSize() + 1;
+  const Vector3f min = volume_.MinBound();
+  const Vector3f voxel_size {
+    volume_.VoxelXSize(), volume_.VoxelYSize(), volume_.VoxelZSize()};
+
+  // the index in mesh_.verts of each vertex, by key() of its address
+  std::unordered_map<size_t, int> vert_offsets;
+  auto position = [&](const Rect &rect, int u, int v) {
+    const Direction &d = directions_[rect.direction];
+    int address[3];
+    address[d.axis] = rect.slice;
+    address[d.u_axis] = u;
+    address[d.v_axis] = v;
+    return Vector3<int> {address[0], address[1], address[2]};
+  };
+  auto key = [&](const Vector3<int> &p) {
+    return (size_t(p.z) * verts_y_size + p.y) * verts_x_size + p.x;
+  };
+  // the vertex at u,v of "rect", or -1 if there's none
+  auto find_vert = [&](const Rect &rect, int u, int v) {
+    auto found = vert_offsets.find(key(position(rect, u, v)));
+    return found == vert_offsets.end() ? -1 : found->second;
+  };
+  auto add_vert = [&](const Vector3<int> &p) {
+    mesh_.verts.push_back(Vector3f {
+      min.x + p.x * voxel_size.x,
+      min.y + p.y * voxel_size.y,
+      min.z + p.z * voxel_size.z
+    });
+    return int(mesh_.verts.size()) - 1;
+  };
+
+  // Every rectangle's corners first, to know every edge's T-junctions. The
+  // corners are a rectangle's first vertices along each edge, in order
+  // counter-clockwise seen from outside the volume. For the negative X, the
+  // positive Y, and the negative Z faces that's counter to u,v order.
+  auto corners = [](const Rect &rect, int (*corner)[2]) {
+    const bool flip = (rect.direction == 0 || rect.direction == 3 ||
+      rect.direction == 4);
+    const int us[4] = {rect.u0, rect.u1, rect.u1, rect.u0};
+    const int vs[4] = {rect.v0, rect.v0, rect.v1, rect.v1};
+    for(int i = 0; i < 4; i++) {
+      corner[i][0] = us[flip ? (4 - i) % 4 : i];
+      corner[i][1] = vs[flip ? (4 - i) % 4 : i];
+    }
+  };
+  for(const Rect &rect: rects_) {
+    int corner[4][2];
+    corners(rect, corner);
+    for(const auto &c: corner) {
+      const Vector3<int> p = position(rect, c[0], c[1]);
+      if(vert_offsets.find(key(p)) == vert_offsets.end()) {
+        vert_offsets[key(p)] = add_vert(p);
+      }
+    }
+  }
+
+  mesh_.has_color = true;
+  AddNormals(&mesh_);
+  std::vector<int> polygon;
+  for(const Rect &rect: rects_) {
+    // the normal's index is that of the opposite direction's BlockFace
+    const int normal = rect.direction ^ 1;
+    auto add_tri = [&](int a, int b, int c) {
+      mesh_.tris.emplace_back(a, b, c, normal, normal, normal, rect.color);
+    };
+
+    int corner[4][2];
+    corners(rect, corner);
+    // the vertices all the way around, counter-clockwise from the first corner
+    polygon.clear();
+    int opposite = 0; // where the corner opposite the first is among them
+    for(int i = 0; i < 4; i++) {
+      const int *from = corner[i], *to = corner[(i + 1) % 4];
+      if(i == 2)
+        opposite = int(polygon.size());
+      polygon.push_back(find_vert(rect, from[0], from[1]));
+      const int du = (to[0] > from[0]) - (to[0] < from[0]);
+      const int dv = (to[1] > from[1]) - (to[1] < from[1]);
+      for(int u = from[0] + du, v = from[1] + dv;
+          u != to[0] || v != to[1]; u += du, v += dv) {
+        const int vert = find_vert(rect, u, v);
+        if(vert != -1)
+          polygon.push_back(vert);
+      }
+    }
+
+    // Zigzag from the first corner to the opposite one, between the chain of
+    // vertices along the 2 edges after the first corner, [1, opposite], and
+    // the chain along the 2 before it, [opposite, n - 1]. A triangle with 2
+    // vertices along one edge is only degenerate if its third is along the
+    // same line, which for each chain means the opposite corner, which is why
+    // neither chain's other end ever reaches it. With no T-junctions this is
+    // a, b, c and b, d, c, as BlockMeshBuilder makes each face.
+    const int n = int(polygon.size());
+    add_tri(polygon[0], polygon[1], polygon[n - 1]);
+    bool advance_first = true;
+    for(int i = 1, j = n - 1; j - i > 1; advance_first = !advance_first) {
+      if(i + 1 == opposite || (!advance_first && j - 1 > opposite)) {
+        add_tri(polygon[i], polygon[j - 1], polygon[j]);
+        j--;
+      } else {
+        add_tri(polygon[i], polygon[i + 1], polygon[j]);
+        i++;
+      }
+    }
+  }
+  std::vector<Rect>().swap(rects_);
+  return std::move(mesh_);
+}
@@ -0,0 +1,179 @@
+#ifndef BLOCK_MESH_H
+#define BLOCK_MESH_H
+
+#include "color.h"
+#include "mesh.h"
+#include "parallel_for.h"
+#include "voxel_volume.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/*
+Builds the mesh that VoxelVolume::CreateBlockMesh makes: a block for each set
+voxel, with 2 triangles for each face exposed to a clear voxel or to the
+outside of the volume, and each vertex shared by every face that touches it.
+
+How the exposed faces are found is up to the caller, who adds them one voxel
+at a time in z-major order. Memory besides the mesh's own is 2 slices of ints,
+whatever the volume's Z size. Each voxel's faces are made in BlockFace order, so
+callers that agree on which faces are exposed make identical meshes, down to
+the order of the vertices and triangles.
+*/
+class BlockMeshBuilder {
+public:
+  // a builder for the faces of the voxels from "z_begin" on; see
+  // BuildBlockMeshInSlabs
+  explicit BlockMeshBuilder(const VoxelVolume &volume, int z_begin = 0);
+
+  // a builder for the faces of only the voxels from x_begin to x_end - 1 and
+  // y_begin to y_end - 1, from "z_begin" on, whose slices of vertices are
+  // only as big as that; see ChunkedBlockMesh
+  BlockMeshBuilder(
+    const VoxelVolume &volume,
+    int x_begin, int x_end, int y_begin, int y_end, int z_begin);
+
+  // Make room for "faces" more faces, to save growing the mesh as they're
+  // added. Shared vertices come to about 1 per face on most surfaces.
+  void Reserve(size_t faces) {
+    mesh_.tris.reserve(mesh_.tris.size() + 2 * faces);
+    mesh_.verts.reserve(mesh_.verts.size() + faces);
+  }
+
+  // make the faces in "faces", a mask of BlockFaces, of voxel x,y,z
+  void AddFaces(int x, int y, int z, int faces, Color color);
+
+  // the mesh made so far; the builder must not be used afterward
+  TriMesh TakeMesh() { return std::move(mesh_); }
+
+  // Join the meshes of builders for consecutive slabs of a volume, in order,
+  // into the mesh a single builder would have made, with each vertex on a
+  // boundary between slabs shared by both. The builders must not be used
+  // afterward.
+  static TriMesh Stitch(std::vector<BlockMeshBuilder> *slabs);
+
+private:
+  // the index in mesh_.verts of vertex x,y,z, creating it if need be
+  int Vert(int x, int y, int z);
+
+  float x_min_, y_min_, z_min_;
+  float voxel_x_size_, voxel_y_size_, voxel_z_size_;
+
+  // start on the faces of voxels at "z", forgetting the vertices below them
+  void AdvanceTo(int z);
+
+  // the index in mesh_.verts of the vertex at "xy" in slice "z", or -1 if
+  // there's none, or it's been forgotten
+  int FindVert(size_t xy, int z) const {
+    if(z != z_ && z != z_ + 1)
+      return -1;
+    return vert_offsets_[(z & 1) * slice_size_ + xy];
+  }
+
+  // "vert_offsets_" maps each vertex's XY address within a slice of vertices,
+  // from x_begin_,y_begin_, to that vertex's offset within mesh_.verts. An
+  // offset of -1 means that vertex hasn't been created in mesh_.verts. Since
+  // there are vertices surrounding every voxel, a slice is bigger by 1 in X
+  // and Y than a slice of voxels. The faces of the voxels at z only touch the
+  // vertices at z and z + 1, and voxels come in z-major order, so only those
+  // 2 slices are kept, as a ring: the vertices at z are in slice z & 1.
+  int x_begin_, y_begin_;
+  int verts_x_size_, verts_y_size_;
+  size_t slice_size_;
+  int z_ = -2; // the z of the voxels being added
+  std::unique_ptr<int[]> vert_offsets_;
+
+  // the offset in mesh_.verts and index within the slice of each vertex at
+  // z_begin_, which a builder for the slab below may share
+  int z_begin_;
+  std::vector<std::pair<int, size_t>> seam_verts_;
+
+  TriMesh mesh_;
+};
+
+/*
+Make a BlockMeshBuilder's mesh with "slabs" slabs of Z meshed in parallel, where
+add_faces(&builder, z_begin, z_end) adds the faces of the voxels from z_begin
+to z_end - 1 as usual. Each slab gets its own builder, and the meshes are then
+stitched together. The mesh is exactly that of a single builder given all the
+faces, however many slabs and threads there are.
+*/
+template<typename Func>
+TriMesh BuildBlockMeshInSlabs(
+  const VoxelVolume &volume, int slabs, Func add_faces
+) {
+  const int z_size = volume.ZSize();
+  slabs = std::max(1, std::min(slabs, z_size));
+  std::vector<BlockMeshBuilder> builders;
+  builders.reserve(slabs);
+  for(int i = 0; i < slabs; i++)
+    builders.emplace_back(volume, SplitRange(0, z_size, slabs, i));
+  ParallelFor(0, slabs, [&](int i) {
+    add_faces(&builders[i], SplitRange(0, z_size, slabs, i),
+      SplitRange(0, z_size, slabs, i + 1));
+  });
+  return BlockMeshBuilder::Stitch(&builders);
+}
+
+/*
+Builds a greedy block mesh: the same surface as BlockMeshBuilder's, with each
+slice's coplanar faces of the same color and direction merged into rectangles.
+A flat wall of n x n faces becomes 2 triangles instead of 2 n^2.
+
+Faces are added the same way as to BlockMeshBuilder, and only collected until
+TakeMesh merges them. The rectangles of each slice are found greedily, each as
+wide as it can be, then as tall. A rectangle's triangles keep the winding and
+normal of the faces it replaces.
+
+The mesh stays watertight: where the corner of one rectangle falls along the
+edge of another, the T-junction would leave a crack, so the edge is split
+there. A rectangle with n vertices around it, corners and splits, takes n - 2
+triangles, and no vertices other than those.
+*/
+class GreedyBlockMeshBuilder {
+public:
+  explicit GreedyBlockMeshBuilder(const VoxelVolume &volume);
+
+  // collect the faces in "faces", a mask of BlockFaces, of voxel x,y,z
+  void AddFaces(int x, int y, int z, int faces, Color color);
+
+  // merge the faces collected, and make the mesh of them
+  TriMesh TakeMesh();
+
+private:
+  // a face, at u,v within its slice; see Direction for which axes u and v are
+  struct Face {
+    int u, v;
+    Color color;
+  };
+
+  // the faces of one BlockFace direction, bucketed by slice
+  struct Direction {
+    int face;       // the BlockFace
+    int axis;       // the axis the faces are perpendicular to: 0, 1, or 2
+    int u_axis, v_axis; // the axes of u and v within the slice
+    int u_size, v_size;
+    // the faces at slice i are those between voxels i - 1 and i
+    std::vector<std::vector<Face>> slices;
+  };
+
+  // a merged rectangle, from u0,v0 to u1,v1 in "slice" of "direction"
+  struct Rect {
+    int direction, slice;
+    int u0, v0, u1, v1;
+    Color color;
+  };
+
+  void MergeSlice(int direction, int slice, std::vector<int> *grid);
+
+  const VoxelVolume &volume_;
+  std::array<Direction, 6> directions_;
+  std::vector<Rect> rects_;
+  TriMesh mesh_;
+};
+
+#endif
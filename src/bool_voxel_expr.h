@@ -0,0 +1,262 @@
+#ifndef BOOL_VOXEL_EXPR_H
+#define BOOL_VOXEL_EXPR_H
+
+#include "bool_voxel_volume.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+/*
+Lazy boolean expressions over BoolVoxelVolumes.
+
+"a | b", "a & b", and "~a" don't compute anything. They build a small tree of
+expression objects, which Eval or EvalInto then computes in a single pass over
+the voxels, one VoxelWord at a time:
+
+  BoolVoxelVolume c = Eval(a | b & ~d); // 1 pass, 1 allocation
+  EvalInto(a | b & ~d, &c);             // 1 pass, no allocation
+
+Whereas a.Union(b.Subtract(d)) makes 2 passes and allocates 2 volumes.
+
+Expressions hold pointers to their operands' voxels, so the operand volumes
+must outlive the expression. That's automatic when the expression is built and
+evaluated in the same statement, as above.
+*/
+
+// an operand: one BasicBoolVoxelVolume
+template<typename Word>
+class VoxelExprLeaf {
+public:
+  using VoxelWord = Word;
+  using Volume = BasicBoolVoxelVolume<Word>;
+
+  // whether any padding bits (see BasicBoolVoxelVolume) of the result might
+  // be 1, and so need masking off
+  static constexpr bool MaySetPadding = false;
+
+  explicit VoxelExprLeaf(const Volume &volume) :
+    volume_(&volume), words_(volume.GetVoxels().data()) {}
+
+  // a volume with the same dimensions as this expression's result
+  const Volume& Shape() const { return *volume_; }
+
+  VoxelWord WordAt(size_t i) const { return words_[i]; }
+
+private:
+  const Volume *volume_;
+  const VoxelWord *words_;
+};
+
+template<typename A, typename B>
+class VoxelExprOr {
+public:
+  using VoxelWord = typename A::VoxelWord;
+  using Volume = typename A::Volume;
+  static_assert(std::is_same<VoxelWord, typename B::VoxelWord>::value);
+
+  static constexpr bool MaySetPadding = A::MaySetPadding || B::MaySetPadding;
+
+  VoxelExprOr(const A &a, const B &b) : a_(a), b_(b) {
+    assert(a.Shape().SameSize(b.Shape()));
+  }
+
+  const Volume& Shape() const { return a_.Shape(); }
+
+  VoxelWord WordAt(size_t i) const { return a_.WordAt(i) | b_.WordAt(i); }
+
+private:
+  A a_;
+  B b_;
+};
+
+template<typename A, typename B>
+class VoxelExprAnd {
+public:
+  using VoxelWord = typename A::VoxelWord;
+  using Volume = typename A::Volume;
+  static_assert(std::is_same<VoxelWord, typename B::VoxelWord>::value);
+
+  static constexpr bool MaySetPadding = A::MaySetPadding && B::MaySetPadding;
+
+  VoxelExprAnd(const A &a, const B &b) : a_(a), b_(b) {
+    assert(a.Shape().SameSize(b.Shape()));
+  }
+
+  const Volume& Shape() const { return a_.Shape(); }
+
+  VoxelWord WordAt(size_t i) const { return a_.WordAt(i) & b_.WordAt(i); }
+
+private:
+  A a_;
+  B b_;
+};
+
+template<typename A>
+class VoxelExprNot {
+public:
+  using VoxelWord = typename A::VoxelWord;
+  using Volume = typename A::Volume;
+
+  static constexpr bool MaySetPadding = true;
+
+  explicit VoxelExprNot(const A &a) : a_(a) {}
+
+  const Volume& Shape() const { return a_.Shape(); }
+
+  VoxelWord WordAt(size_t i) const { return VoxelWord(~a_.WordAt(i)); }
+
+private:
+  A a_;
+};
+
+// IsVoxelExpr<T> is true for BasicBoolVoxelVolume and the expression classes
+template<typename T> struct IsVoxelExpr : std::false_type {};
+template<typename Word>
+struct IsVoxelExpr<BasicBoolVoxelVolume<Word>> : std::true_type {};
+template<typename Word>
+struct IsVoxelExpr<VoxelExprLeaf<Word>> : std::true_type {};
+template<typename A, typename B>
+struct IsVoxelExpr<VoxelExprOr<A,B>> : std::true_type {};
+template<typename A, typename B>
+struct IsVoxelExpr<VoxelExprAnd<A,B>> : std::true_type {};
+template<typename A>
+struct IsVoxelExpr<VoxelExprNot<A>> : std::true_type {};
+
+// wrap volumes in VoxelExprLeaf; pass expressions through as they are
+template<typename Word>
+VoxelExprLeaf<Word> ToVoxelExpr(const BasicBoolVoxelVolume<Word> &volume) {
+  return VoxelExprLeaf<Word>(volume);
+}
+
+template<typename Expr>
+const Expr& ToVoxelExpr(const Expr &expr) {
+  return expr;
+}
+
+template<typename T>
+using VoxelExprOf = std::decay_t<decltype(ToVoxelExpr(std::declval<T>()))>;
+
+template<typename A, typename B,
+  typename = std::enable_if_t<IsVoxelExpr<A>::value && IsVoxelExpr<B>::value>>
+VoxelExprOr<VoxelExprOf<A>, VoxelExprOf<B>> operator|(const A &a, const B &b) {
+  return {ToVoxelExpr(a), ToVoxelExpr(b)};
+}
+
+template<typename A, typename B,
+  typename = std::enable_if_t<IsVoxelExpr<A>::value && IsVoxelExpr<B>::value>>
+VoxelExprAnd<VoxelExprOf<A>, VoxelExprOf<B>> operator&(const A &a, const B &b) {
+  return {ToVoxelExpr(a), ToVoxelExpr(b)};
+}
+
+template<typename A, typename = std::enable_if_t<IsVoxelExpr<A>::value>>
+VoxelExprNot<VoxelExprOf<A>> operator~(const A &a) {
+  return VoxelExprNot<VoxelExprOf<A>>(ToVoxelExpr(a));
+}
+
+// Compute "expr" into "dest", which must already have the same dimensions.
+// "dest" may also be one of the operands, e.g. EvalInto(a | b, &a). Only the
+// chunks of "dest" whose voxels change are marked dirty, so updating an
+// operand in place with a small operand dirties only what it touches.
+template<typename Expr>
+void EvalInto(
+  const Expr &expr, typename VoxelExprOf<Expr>::Volume *dest
+) {
+  static_assert(IsVoxelExpr<Expr>::value);
+  using E = VoxelExprOf<Expr>;
+  using VoxelWord = typename E::VoxelWord;
+  constexpr int VoxelsPerWord = E::Volume::VoxelsPerWord;
+  static_assert(DirtyChunks::XSize % VoxelsPerWord == 0);
+  constexpr int chunk_words = DirtyChunks::XSize / VoxelsPerWord;
+
+  const E &e = ToVoxelExpr(expr);
+  assert(dest->SameSize(e.Shape()));
+
+  const VoxelWord last_word_mask = dest->LastWordMask();
+
+  VoxelWord *dest_words = dest->MutableVoxels();
+  DirtyChunks &dirty = dest->Dirty();
+  const int x_words = dest->XWords();
+  const int y_size = dest->YSize();
+  const size_t slice_words = size_t(x_words) * y_size;
+  // which bits of each word of a slice change
+  std::vector<VoxelWord> changed;
+  for(int z = 0; z < dest->ZSize(); z++) {
+    const size_t slice = z * slice_words;
+    VoxelWord *slice_dest = dest_words + slice;
+    // complements set the padding bits at the end of each row; clear them
+    auto clear_padding = [&](VoxelWord *words) {
+      if(E::MaySetPadding && last_word_mask != VoxelWord(~VoxelWord(0))) {
+        for(size_t i = x_words - 1; i < slice_words; i += x_words)
+          words[i] &= last_word_mask;
+      }
+    };
+
+    // nothing to find out when every chunk the slice is in, e.g. of a new
+    // volume, is dirty already
+    if(dirty.IsSlabDirty(z >> DirtyChunks::ZBits)) {
+      for(size_t i = 0; i < slice_words; i++)
+        slice_dest[i] = e.WordAt(slice + i);
+      clear_padding(slice_dest);
+      continue;
+    }
+
+    // Slices that don't change, usually most of them when updating a volume
+    // in place, are only read. The rest are still in cache to compute again.
+    // (Padding bits set by complements look like changes here, but not once
+    // they're cleared below.)
+    VoxelWord any_changed = 0;
+    for(size_t i = 0; i < slice_words; i++)
+      any_changed |= VoxelWord(e.WordAt(slice + i) ^ slice_dest[i]);
+    if(!any_changed)
+      continue;
+    changed.resize(slice_words);
+    for(size_t i = 0; i < slice_words; i++) {
+      const VoxelWord w = e.WordAt(slice + i);
+      changed[i] = VoxelWord(w ^ slice_dest[i]);
+      slice_dest[i] = w;
+    }
+    clear_padding(slice_dest);
+    clear_padding(changed.data());
+
+    // Which chunks the changes are in: fold each chunk's rows in half onto
+    // themselves, ORing, until they're down to 1 row, in loops over whole
+    // rows at a time rather than a few words.
+    for(int y = 0; y < y_size; y += DirtyChunks::YSize) {
+      VoxelWord *rows_changed = changed.data() + size_t(y) * x_words;
+      for(int rows = std::min(y_size - y, int(DirtyChunks::YSize)); rows > 1;) {
+        const int half = rows / 2, kept = rows - half;
+        const size_t words = size_t(half) * x_words;
+        const VoxelWord *folded = rows_changed + size_t(kept) * x_words;
+        for(size_t i = 0; i < words; i++)
+          rows_changed[i] |= folded[i];
+        rows = kept;
+      }
+      for(int chunk = 0; chunk * chunk_words < x_words; chunk++) {
+        const int word_end = std::min(x_words, (chunk + 1) * chunk_words);
+        VoxelWord chunk_changed = 0;
+        for(int word = chunk * chunk_words; word < word_end; word++)
+          chunk_changed |= rows_changed[word];
+        if(chunk_changed) {
+          dirty.MarkChunk(
+            chunk, y >> DirtyChunks::YBits, z >> DirtyChunks::ZBits);
+        }
+      }
+    }
+  }
+}
+
+// compute "expr" into a new volume
+template<typename Expr>
+typename VoxelExprOf<Expr>::Volume Eval(const Expr &expr) {
+  static_assert(IsVoxelExpr<Expr>::value);
+  const auto &shape = ToVoxelExpr(expr).Shape();
+  typename VoxelExprOf<Expr>::Volume result(
+    shape.XSize(), shape.YSize(), shape.ZSize());
+  EvalInto(expr, &result);
+  return result;
+}
+
+#endif
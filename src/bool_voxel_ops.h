@@ -0,0 +1,1026 @@
+#ifndef BOOL_VOXEL_OPS_H
+#define BOOL_VOXEL_OPS_H
+
+#include "bit_transpose.h"
+#include "math/vector.h"
+#include "voxel_kernels.h"
+#include "voxel_volume.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+/*
+The word-level algorithms behind BasicBoolVoxelVolume and FixedBoolVoxelVolume.
+
+Both volumes pack voxels the same way (see BasicBoolVoxelVolume): 1 bit per
+voxel, z-major, each row padded to a whole number of words, padding bits 0.
+They differ only in whether the dimensions are known at compile time, which is
+captured by a Layout class:
+
+  BoolVoxelLayout<Word>                - dimensions chosen at run time
+  FixedBoolVoxelLayout<Word, X, Y, Z>  - dimensions are compile-time constants
+
+With a FixedBoolVoxelLayout every stride and trip count below is a constant, so
+the compiler can unroll and vectorize the loops.
+
+Operations on long runs of words are delegated to a WordOps class:
+
+  KernelWordOps - calls the runtime-dispatched VoxelKernels; best for big
+                  volumes whose size isn't known until run time
+  InlineWordOps - plain loops, which inline into the caller; best when the
+                  size is small and fixed
+
+Unless noted otherwise, each "...Words" function reads "source" and writes
+"dest", which must not overlap, and "dest" must start out all 0.
+*/
+
+template<typename Word>
+class BoolVoxelLayout {
+public:
+  using VoxelWord = Word;
+  static constexpr int VoxelsPerWord = std::numeric_limits<VoxelWord>::digits;
+
+  BoolVoxelLayout(int x_size, int y_size, int z_size) :
+    x_size_(x_size), y_size_(y_size), z_size_(z_size),
+    x_words_((x_size + VoxelsPerWord - 1) / VoxelsPerWord) {}
+
+  int XSize() const { return x_size_; }
+  int YSize() const { return y_size_; }
+  int ZSize() const { return z_size_; }
+
+  // size in VoxelWords of one row, one XY slab, and the whole volume
+  int XWords() const { return x_words_; }
+  int YStride() const { return x_words_; }
+  int ZStride() const { return x_words_ * y_size_; }
+  size_t NumWords() const { return size_t(ZStride()) * z_size_; }
+
+  // the valid (non-padding) bits of the last word in each row
+  VoxelWord LastWordMask() const {
+    int used_bits = x_size_ - (x_words_ - 1) * VoxelsPerWord;
+    return VoxelWord(~VoxelWord(0)) >> (VoxelsPerWord - used_bits);
+  }
+
+  // zeroed scratch space for one row, or the whole volume
+  using RowBuffer = std::vector<VoxelWord>;
+  RowBuffer MakeRowBuffer() const { return RowBuffer(x_words_); }
+  using VolumeBuffer = std::vector<VoxelWord>;
+  VolumeBuffer MakeVolumeBuffer() const { return VolumeBuffer(NumWords()); }
+
+private:
+  int x_size_, y_size_, z_size_;
+  int x_words_;
+};
+
+template<typename Word, int X, int Y, int Z>
+class FixedBoolVoxelLayout {
+public:
+  using VoxelWord = Word;
+  static constexpr int VoxelsPerWord = std::numeric_limits<VoxelWord>::digits;
+  static_assert(X > 0 && Y > 0 && Z > 0);
+
+  static constexpr int XSize() { return X; }
+  static constexpr int YSize() { return Y; }
+  static constexpr int ZSize() { return Z; }
+
+  static constexpr int XWords() {
+    return (X + VoxelsPerWord - 1) / VoxelsPerWord;
+  }
+  static constexpr int YStride() { return XWords(); }
+  static constexpr int ZStride() { return XWords() * Y; }
+  static constexpr size_t NumWords() { return size_t(ZStride()) * Z; }
+
+  static constexpr VoxelWord LastWordMask() {
+    return VoxelWord(~VoxelWord(0)) >>
+      (VoxelsPerWord - (X - (XWords() - 1) * VoxelsPerWord));
+  }
+
+  using RowBuffer = std::array<VoxelWord, XWords()>;
+  static RowBuffer MakeRowBuffer() { return RowBuffer{}; }
+  using VolumeBuffer = std::array<VoxelWord, NumWords()>;
+  static VolumeBuffer MakeVolumeBuffer() { return VolumeBuffer{}; }
+};
+
+// WordOps ///////////////////////////////////////////////////////////////////
+
+class KernelWordOps {
+public:
+  template<typename Word>
+  static void Or(const Word *a, const Word *b, Word *c, size_t words) {
+    GetVoxelKernels().Or(a, b, c, words * sizeof(Word));
+  }
+
+  template<typename Word>
+  static void And(const Word *a, const Word *b, Word *c, size_t words) {
+    GetVoxelKernels().And(a, b, c, words * sizeof(Word));
+  }
+
+  template<typename Word>
+  static void AndNot(const Word *a, const Word *b, Word *c, size_t words) {
+    GetVoxelKernels().AndNot(a, b, c, words * sizeof(Word));
+  }
+
+  template<typename Word>
+  static bool AnySet(const Word *a, size_t words) {
+    return GetVoxelKernels().AnySet(a, words * sizeof(Word));
+  }
+
+  template<typename Word>
+  static void SweepRows(
+    const Word *source, const Word *fill_row, Word *dest,
+    size_t row_words, size_t rows
+  ) {
+    GetVoxelKernels().SweepRows(
+      source, fill_row, dest, row_words * sizeof(Word), rows);
+  }
+};
+
+class InlineWordOps {
+public:
+  template<typename Word>
+  static void Or(const Word *a, const Word *b, Word *c, size_t words) {
+    for(size_t i = 0; i < words; i++)
+      c[i] = a[i] | b[i];
+  }
+
+  template<typename Word>
+  static void And(const Word *a, const Word *b, Word *c, size_t words) {
+    for(size_t i = 0; i < words; i++)
+      c[i] = a[i] & b[i];
+  }
+
+  template<typename Word>
+  static void AndNot(const Word *a, const Word *b, Word *c, size_t words) {
+    for(size_t i = 0; i < words; i++)
+      c[i] = a[i] & ~b[i];
+  }
+
+  // OR everything together, rather than exiting early, so the loop vectorizes
+  template<typename Word>
+  static bool AnySet(const Word *a, size_t words) {
+    Word any = 0;
+    for(size_t i = 0; i < words; i++)
+      any |= a[i];
+    return any;
+  }
+
+  template<typename Word>
+  static void SweepRows(
+    const Word *source, const Word *fill_row, Word *dest,
+    size_t row_words, size_t rows
+  ) {
+    for(size_t row = 0; row < rows; row++) {
+      if(AnySet(source, row_words))
+        memcpy(dest, fill_row, row_words * sizeof(Word));
+      source += row_words;
+      dest += row_words;
+    }
+  }
+};
+
+// bit tricks ////////////////////////////////////////////////////////////////
+
+// set every bit at or above the lowest set bit
+template<typename Word>
+Word FillUp(Word w) {
+  return w | Word(~w + 1);
+}
+
+// set every bit at or below the highest set bit
+template<typename Word>
+Word FillDown(Word w) {
+  for(int shift = 1; shift < std::numeric_limits<Word>::digits; shift <<= 1)
+    w |= w >> shift;
+  return w;
+}
+
+// Number of set bits. A single instruction in code compiled for a target that
+// has one, as StatsWords is where the CPU has popcnt, so it's always inlined
+// into its caller to be compiled for the caller's target.
+template<typename Word>
+inline __attribute__((always_inline)) int PopCount(Word w) {
+  static_assert(std::numeric_limits<Word>::digits <= 64);
+  return __builtin_popcountll(w);
+}
+
+// index of the lowest set bit; "w" must not be 0
+template<typename Word>
+int LowestSetBit(Word w) {
+  return __builtin_ctzll(w);
+}
+
+// pack the even bits of "w", whose odd bits must be 0, into its low half
+template<typename Word>
+Word CompactEvenBits(Word w) {
+  constexpr int Bits = std::numeric_limits<Word>::digits;
+  // each step halves the gaps; the masks are 0b0011..., 0b00001111..., etc.
+  for(int shift = 1; shift < Bits / 2; shift <<= 1) {
+    const Word mask =
+      Word(Word(~Word(0)) / Word((Word(1) << (2 * shift)) + 1));
+    w = Word(w | (w >> shift)) & mask;
+  }
+  return w;
+}
+
+// set bits "begin" to "end" - 1 of a row of words
+template<typename Word>
+void SetBitRange(Word *row, int begin, int end) {
+  constexpr int VoxelsPerWord = std::numeric_limits<Word>::digits;
+  if(begin >= end)
+    return;
+  const Word all = Word(~Word(0));
+  const int first_word = begin / VoxelsPerWord;
+  const int last_word = (end - 1) / VoxelsPerWord;
+  const Word first_mask = Word(all << (begin % VoxelsPerWord));
+  const Word last_mask =
+    Word(all >> (VoxelsPerWord - 1 - (end - 1) % VoxelsPerWord));
+  if(first_word == last_word) {
+    row[first_word] |= Word(first_mask & last_mask);
+    return;
+  }
+  row[first_word] |= first_mask;
+  for(int i = first_word + 1; i < last_word; i++)
+    row[i] = all;
+  row[last_word] |= last_mask;
+}
+
+// sweeps ////////////////////////////////////////////////////////////////////
+
+template<typename WordOps, typename Layout>
+void SweepXWords(
+  const Layout &layout,
+  const typename Layout::VoxelWord *source, typename Layout::VoxelWord *dest
+) {
+  using VoxelWord = typename Layout::VoxelWord;
+  const int x_words = layout.XWords();
+
+  typename Layout::RowBuffer full_row = layout.MakeRowBuffer();
+  std::fill(full_row.begin(), full_row.end(), VoxelWord(~VoxelWord(0)));
+  full_row[x_words - 1] = layout.LastWordMask();
+
+  WordOps::SweepRows(
+    source, full_row.data(), dest, x_words, layout.YSize() * layout.ZSize());
+}
+
+template<typename WordOps, typename Layout>
+void SweepYWords(
+  const Layout &layout,
+  const typename Layout::VoxelWord *source, typename Layout::VoxelWord *dest
+) {
+  const int y_stride = layout.YStride();
+  const int y_size = layout.YSize();
+  const size_t row_bytes = y_stride * sizeof(*dest);
+
+  for(int z = 0; z < layout.ZSize(); z++) {
+    // OR together all the rows in this slab into the first row, then copy
+    // that to every other row
+    for(int y = 0; y < y_size; y++)
+      WordOps::Or(dest, source + y * y_stride, dest, y_stride);
+    for(int y = 1; y < y_size; y++)
+      memcpy(dest + y * y_stride, dest, row_bytes);
+    source += layout.ZStride();
+    dest += layout.ZStride();
+  }
+}
+
+template<typename WordOps, typename Layout>
+void SweepZWords(
+  const Layout &layout,
+  const typename Layout::VoxelWord *source, typename Layout::VoxelWord *dest
+) {
+  const int z_stride = layout.ZStride();
+  const size_t slab_bytes = z_stride * sizeof(*dest);
+
+  // OR all the slabs together into the first slab, then copy it to the rest
+  for(int z = 0; z < layout.ZSize(); z++)
+    WordOps::Or(dest, source + z * z_stride, dest, z_stride);
+  for(int z = 1; z < layout.ZSize(); z++)
+    memcpy(dest + z * z_stride, dest, slab_bytes);
+}
+
+template<typename WordOps, typename Layout>
+void SweepPositiveWords(
+  const Layout &layout, Axis axis,
+  const typename Layout::VoxelWord *source, typename Layout::VoxelWord *dest
+) {
+  using VoxelWord = typename Layout::VoxelWord;
+  const int x_words = layout.XWords();
+  const int y_stride = layout.YStride();
+  const int z_stride = layout.ZStride();
+
+  switch(axis) {
+  case Axis::X:
+    // within a row, fill up from the lowest set bit of the first non-zero
+    // word; every word after that is full, except for padding
+    for(int row = 0; row < layout.YSize() * layout.ZSize(); row++) {
+      bool filled = false;
+      for(int x = 0; x < x_words; x++) {
+        VoxelWord word = source[x];
+        dest[x] = filled ? VoxelWord(~VoxelWord(0)) : FillUp(word);
+        filled = filled || word;
+      }
+      dest[x_words - 1] &= layout.LastWordMask();
+      source += y_stride;
+      dest += y_stride;
+    }
+    break;
+
+  case Axis::Y:
+    // each row is the OR of itself and the previous (already swept) row
+    for(int z = 0; z < layout.ZSize(); z++) {
+      memcpy(dest, source, y_stride * sizeof(VoxelWord));
+      for(int y = 1; y < layout.YSize(); y++) {
+        WordOps::Or(dest + (y-1) * y_stride, source + y * y_stride,
+          dest + y * y_stride, y_stride);
+      }
+      source += z_stride;
+      dest += z_stride;
+    }
+    break;
+
+  case Axis::Z:
+    // each slab is the OR of itself and the previous (already swept) slab
+    memcpy(dest, source, z_stride * sizeof(VoxelWord));
+    for(int z = 1; z < layout.ZSize(); z++) {
+      WordOps::Or(dest + (z-1) * z_stride, source + z * z_stride,
+        dest + z * z_stride, z_stride);
+    }
+    break;
+  }
+}
+
+template<typename WordOps, typename Layout>
+void SweepNegativeWords(
+  const Layout &layout, Axis axis,
+  const typename Layout::VoxelWord *source, typename Layout::VoxelWord *dest
+) {
+  using VoxelWord = typename Layout::VoxelWord;
+  const int x_words = layout.XWords();
+  const int y_stride = layout.YStride();
+  const int z_stride = layout.ZStride();
+
+  switch(axis) {
+  case Axis::X:
+    // within a row, fill down from the highest set bit of the last non-zero
+    // word; every word before that is full
+    for(int row = 0; row < layout.YSize() * layout.ZSize(); row++) {
+      bool filled = false;
+      for(int x = x_words - 1; x >= 0; x--) {
+        VoxelWord word = source[x];
+        dest[x] = filled ? VoxelWord(~VoxelWord(0)) : FillDown(word);
+        filled = filled || word;
+      }
+      source += y_stride;
+      dest += y_stride;
+    }
+    break;
+
+  case Axis::Y:
+    // each row is the OR of itself and the next (already swept) row
+    for(int z = 0; z < layout.ZSize(); z++) {
+      const int last = (layout.YSize() - 1) * y_stride;
+      memcpy(dest + last, source + last, y_stride * sizeof(VoxelWord));
+      for(int i = last - y_stride; i >= 0; i -= y_stride)
+        WordOps::Or(dest + i + y_stride, source + i, dest + i, y_stride);
+      source += z_stride;
+      dest += z_stride;
+    }
+    break;
+
+  case Axis::Z: {
+    // each slab is the OR of itself and the next (already swept) slab
+    const int last = (layout.ZSize() - 1) * z_stride;
+    memcpy(dest + last, source + last, z_stride * sizeof(VoxelWord));
+    for(int i = last - z_stride; i >= 0; i -= z_stride)
+      WordOps::Or(dest + i + z_stride, source + i, dest + i, z_stride);
+    break;
+  }
+  }
+}
+
+// morphology //////////////////////////////////////////////////////////////
+
+/*
+Dilation sets every voxel with a set neighbor; erosion clears every voxel with
+a clear neighbor. Voxels outside the volume count as clear, so erosion also
+eats away at the volume's faces.
+
+Both work on whole words. A voxel's X neighbors are lined up with it by
+shifting its row 1 bit each way; its Y and Z neighbors are simply the rows
+before and after it. Dilation ORs these together, erosion ANDs them, so each
+word operation handles VoxelsPerWord voxels.
+
+The 26-neighborhood is a 3x3x3 box, which is separable: combining each voxel
+with its X neighbors, then the result with its Y neighbors, then Z, covers all
+26. The 6-neighborhood is a cross, the union (or intersection) of the three
+1D neighborhoods.
+*/
+
+enum class MorphologyOp { Dilate, Erode };
+
+struct OrWordOp {
+  template<typename Word>
+  Word operator()(Word a, Word b) const { return a | b; }
+};
+
+struct AndWordOp {
+  template<typename Word>
+  Word operator()(Word a, Word b) const { return a & b; }
+};
+
+// Combine each voxel with its 2 X neighbors using "op". "dest" may start out
+// with any contents.
+template<typename Layout, typename Op>
+void CombineXNeighborsWords(
+  const Layout &layout,
+  const typename Layout::VoxelWord *source, typename Layout::VoxelWord *dest,
+  Op op
+) {
+  using VoxelWord = typename Layout::VoxelWord;
+  constexpr int VoxelsPerWord = Layout::VoxelsPerWord;
+  const int x_words = layout.XWords();
+  const VoxelWord last_word_mask = layout.LastWordMask();
+
+  for(int row = 0; row < layout.YSize() * layout.ZSize(); row++) {
+    for(int i = 0; i < x_words; i++) {
+      const VoxelWord word = source[i];
+      const VoxelWord lower = (i > 0 ? source[i-1] : 0);
+      const VoxelWord higher = (i + 1 < x_words ? source[i+1] : 0);
+      // bit x of each of these is voxel x - 1 and x + 1 respectively; bits
+      // shifted in from beyond the row are padding or 0
+      const VoxelWord from_lower =
+        VoxelWord(word << 1) | VoxelWord(lower >> (VoxelsPerWord - 1));
+      const VoxelWord from_higher =
+        VoxelWord(word >> 1) | VoxelWord(higher << (VoxelsPerWord - 1));
+      dest[i] = op(op(from_lower, word), from_higher);
+    }
+    dest[x_words - 1] &= last_word_mask;
+    source += x_words;
+    dest += x_words;
+  }
+}
+
+// Combine each voxel with its 2 neighbors along "axis", which is Y or Z, using
+// "op". "dest" may start out with any contents.
+template<typename Layout, typename Op>
+void CombineRowNeighborsWords(
+  const Layout &layout, Axis axis,
+  const typename Layout::VoxelWord *source, typename Layout::VoxelWord *dest,
+  Op op
+) {
+  assert(axis != Axis::X);
+  const int x_words = layout.XWords();
+  const int stride =
+    (axis == Axis::Y ? layout.YStride() : layout.ZStride());
+  const int size = (axis == Axis::Y ? layout.YSize() : layout.ZSize());
+  const typename Layout::RowBuffer zero_row = layout.MakeRowBuffer();
+
+  for(int z = 0; z < layout.ZSize(); z++) {
+    for(int y = 0; y < layout.YSize(); y++) {
+      const int offset = z * layout.ZStride() + y * layout.YStride();
+      const int position = (axis == Axis::Y ? y : z);
+      const auto *row = source + offset;
+      const auto *before = (position > 0 ? row - stride : zero_row.data());
+      const auto *after =
+        (position < size - 1 ? row + stride : zero_row.data());
+      auto *dest_row = dest + offset;
+      for(int i = 0; i < x_words; i++)
+        dest_row[i] = op(op(before[i], row[i]), after[i]);
+    }
+  }
+}
+
+// one step of dilation or erosion, from "source" into "dest", using two
+// volumes of scratch space
+template<typename Layout, typename Op>
+void MorphologyStepWords(
+  const Layout &layout, Neighborhood neighborhood,
+  const typename Layout::VoxelWord *source, typename Layout::VoxelWord *dest,
+  typename Layout::VoxelWord *scratch_a, typename Layout::VoxelWord *scratch_b,
+  Op op
+) {
+  if(neighborhood == Neighborhood::TwentySix) {
+    CombineXNeighborsWords(layout, source, scratch_a, op);
+    CombineRowNeighborsWords(layout, Axis::Y, scratch_a, scratch_b, op);
+    CombineRowNeighborsWords(layout, Axis::Z, scratch_b, dest, op);
+  } else {
+    CombineXNeighborsWords(layout, source, scratch_a, op);
+    CombineRowNeighborsWords(layout, Axis::Y, source, scratch_b, op);
+    CombineRowNeighborsWords(layout, Axis::Z, source, dest, op);
+    const size_t num_words = layout.NumWords();
+    for(size_t i = 0; i < num_words; i++)
+      dest[i] = op(op(dest[i], scratch_a[i]), scratch_b[i]);
+  }
+}
+
+// "iterations" steps of dilation or erosion. Unlike the other "...Words"
+// functions, "dest" may start out with any contents.
+template<typename Layout>
+void MorphologyWords(
+  const Layout &layout, MorphologyOp op, Neighborhood neighborhood,
+  int iterations,
+  const typename Layout::VoxelWord *source, typename Layout::VoxelWord *dest
+) {
+  assert(iterations >= 0);
+  if(iterations == 0) {
+    memcpy(dest, source, layout.NumWords() * sizeof(*dest));
+    return;
+  }
+
+  typename Layout::VolumeBuffer scratch_a = layout.MakeVolumeBuffer();
+  typename Layout::VolumeBuffer scratch_b = layout.MakeVolumeBuffer();
+  typename Layout::VolumeBuffer between;
+  if(iterations > 1)
+    between = layout.MakeVolumeBuffer();
+
+  // alternate between "dest" and "between" so the last step lands in "dest"
+  const typename Layout::VoxelWord *step_source = source;
+  for(int i = 0; i < iterations; i++) {
+    auto *step_dest = ((iterations - i) % 2 == 1 ? dest : between.data());
+    if(op == MorphologyOp::Dilate) {
+      MorphologyStepWords(layout, neighborhood, step_source, step_dest,
+        scratch_a.data(), scratch_b.data(), OrWordOp());
+    } else {
+      MorphologyStepWords(layout, neighborhood, step_source, step_dest,
+        scratch_a.data(), scratch_b.data(), AndWordOp());
+    }
+    step_source = step_dest;
+  }
+}
+
+// downsampling //////////////////////////////////////////////////////////////
+
+/*
+Halving a volume in each dimension: each voxel of the coarser volume stands for
+a 2x2x2 block of the finer one, and is set according to a vote of the block's
+voxels, where voxels beyond the finer volume count as clear:
+
+  LodVote::Any      - if any voxel of the block is set, so a coarse voxel is
+                      clear only where the space is empty, e.g. for skipping
+                      empty space when tracing rays
+  LodVote::Majority - if at least half of the block, 4 of its 8 voxels, is set,
+                      which keeps the rough shape, e.g. for distant meshes
+
+The 4 rows of a block row are combined a word at a time. For Any, they're ORed
+together, and each pair of bits ORed. For Majority, each bit position's count
+of set voxels in the 4 rows, 0 to 4, is added up as a 3-bit number in 3 words,
+and the counts of each pair of positions are then compared with 4, as in a
+hardware adder. Either way the result is in the even bits, which are packed
+together into half a word.
+*/
+
+enum class LodVote { Any, Majority };
+
+// Downsample the voxels at "dest_z_begin" to "dest_z_end" - 1 of "dest", which
+// is half the size of "source" in each dimension, rounded up. "dest" may start
+// out with any contents.
+template<typename Layout, typename DestLayout>
+void DownsampleWords(
+  const Layout &layout, const DestLayout &dest_layout, LodVote vote,
+  const typename Layout::VoxelWord *source,
+  typename DestLayout::VoxelWord *dest, int dest_z_begin, int dest_z_end
+) {
+  using VoxelWord = typename Layout::VoxelWord;
+  static_assert(
+    std::is_same<VoxelWord, typename DestLayout::VoxelWord>::value);
+  constexpr int VoxelsPerWord = Layout::VoxelsPerWord;
+  assert(dest_layout.XSize() == (layout.XSize() + 1) / 2);
+  assert(dest_layout.YSize() == (layout.YSize() + 1) / 2);
+  assert(dest_layout.ZSize() == (layout.ZSize() + 1) / 2);
+  const VoxelWord even = VoxelWord(VoxelWord(~VoxelWord(0)) / 3);
+  const int x_words = layout.XWords();
+  const typename Layout::RowBuffer zero_row = layout.MakeRowBuffer();
+
+  for(int z = dest_z_begin; z < dest_z_end; z++) {
+    for(int y = 0; y < dest_layout.YSize(); y++) {
+      const VoxelWord *row = source +
+        2 * z * layout.ZStride() + 2 * y * layout.YStride();
+      const bool has_y = (2 * y + 1 < layout.YSize());
+      const bool has_z = (2 * z + 1 < layout.ZSize());
+      const VoxelWord *rows[4] = {
+        row,
+        has_y ? row + layout.YStride() : zero_row.data(),
+        has_z ? row + layout.ZStride() : zero_row.data(),
+        has_y && has_z ?
+          row + layout.YStride() + layout.ZStride() : zero_row.data()
+      };
+      VoxelWord *dest_row =
+        dest + z * dest_layout.ZStride() + y * dest_layout.YStride();
+
+      for(int i = 0; i < dest_layout.XWords(); i++) {
+        VoxelWord packed = 0;
+        // the 2 source words whose voxels make this word's low and high half
+        for(int half = 0; half < 2 && 2 * i + half < x_words; half++) {
+          const int j = 2 * i + half;
+          const VoxelWord a = rows[0][j], b = rows[1][j];
+          const VoxelWord c = rows[2][j], d = rows[3][j];
+          VoxelWord voted;
+          if(vote == LodVote::Any) {
+            const VoxelWord any = a | b | c | d;
+            voted = VoxelWord(any | (any >> 1)) & even;
+          } else {
+            // count0 + 2 count1 + 4 count2 = a + b + c + d, per bit
+            const VoxelWord ab = a ^ b, cd = c ^ d;
+            const VoxelWord ab_carry = a & b, cd_carry = c & d;
+            const VoxelWord carry = ab & cd;
+            const VoxelWord count0 = ab ^ cd;
+            const VoxelWord count1 = ab_carry ^ cd_carry ^ carry;
+            const VoxelWord count2 =
+              (ab_carry & cd_carry) | (carry & (ab_carry ^ cd_carry));
+            // whether the count of each even bit plus its odd neighbor's is
+            // at least 4
+            const VoxelWord count0_odd = count0 >> 1;
+            const VoxelWord count1_odd = count1 >> 1;
+            const VoxelWord count2_odd = count2 >> 1;
+            voted = VoxelWord(count2 | count2_odd | (count1 & count1_odd) |
+              ((count1 ^ count1_odd) & count0 & count0_odd)) & even;
+          }
+          packed |= VoxelWord(CompactEvenBits(voted) <<
+            (half * VoxelsPerWord / 2));
+        }
+        // padding bits come from the source's padding, or beyond the row, so
+        // they're 0
+        dest_row[i] = packed;
+      }
+    }
+  }
+}
+
+// statistics ////////////////////////////////////////////////////////////////
+
+struct BoolVoxelStats {
+  size_t count = 0; // number of set voxels
+
+  // number of faces between a set voxel and a clear voxel or the outside of
+  // the volume; CreateBlockMesh makes 2 triangles per exposed face
+  size_t exposed_faces = 0;
+
+  // tight bounding box of the set voxels, from "min" (inclusive) to "max"
+  // (exclusive), in voxel addresses. Both are 0 if no voxels are set.
+  Vector3<int> min {}, max {};
+
+  // mean position of the set voxels, in voxel units: voxel x,y,z spans
+  // x..x+1, y..y+1, z..z+1, so a lone voxel at 0,0,0 has centroid 0.5,0.5,0.5
+  Vector3d centroid {};
+
+  // number of set voxels in each slice perpendicular to each axis, e.g.
+  // x_counts[x] is the number of set voxels at x
+  std::vector<size_t> x_counts, y_counts, z_counts;
+};
+
+/*
+Compute BoolVoxelStats in a single pass over the words.
+
+The exposed faces are counted a direction at a time. Along each line of voxels
+parallel to an axis, every run of set voxels has exactly one face exposed at
+each end, so the faces are twice the number of runs. A run starts at each set
+voxel whose predecessor is clear: "word & ~predecessors", where predecessors
+is the same word of the previous row (Y), or slab (Z), or the word shifted up
+by one bit (X). PopCount counts those starts a word at a time.
+
+The Y and Z histograms are each row's PopCounts. The X histogram needs the
+count at each bit position of the words of a column of rows instead, so the
+words of VoxelsPerWord rows at a time are transposed, a block per word of the
+row, making each word of a block one X position, for PopCount to count.
+*/
+template<typename Layout>
+inline __attribute__((always_inline)) BoolVoxelStats StatsWordsLoop(
+  const Layout &layout, const typename Layout::VoxelWord *source
+) {
+  using VoxelWord = typename Layout::VoxelWord;
+  constexpr int VoxelsPerWord = Layout::VoxelsPerWord;
+  const int x_words = layout.XWords();
+  const int y_stride = layout.YStride();
+  const int z_stride = layout.ZStride();
+  const typename Layout::RowBuffer zero_row = layout.MakeRowBuffer();
+
+  BoolVoxelStats stats;
+  // up to the end of the last word, until the padding is cut off below
+  stats.x_counts.resize(size_t(x_words) * VoxelsPerWord);
+  stats.y_counts.resize(layout.YSize());
+  stats.z_counts.resize(layout.ZSize());
+
+  struct Block { VoxelWord rows[VoxelsPerWord]; };
+  std::vector<Block> blocks(x_words);
+  int block_rows = 0;
+
+  size_t runs = 0;
+  for(int z = 0; z < layout.ZSize(); z++) {
+    for(int y = 0; y < layout.YSize(); y++) {
+      const VoxelWord *row = source + z * z_stride + y * y_stride;
+      const VoxelWord *y_before = (y > 0 ? row - y_stride : zero_row.data());
+      const VoxelWord *z_before = (z > 0 ? row - z_stride : zero_row.data());
+
+      size_t row_count = 0;
+      VoxelWord carry = 0; // the previous word's highest bit, shifted down
+      for(int i = 0; i < x_words; i++) {
+        const VoxelWord word = row[i];
+        const VoxelWord x_before = VoxelWord(word << 1) | carry;
+        carry = VoxelWord(word >> (VoxelsPerWord - 1));
+
+        row_count += PopCount(word);
+        runs += PopCount(VoxelWord(word & ~x_before));
+        runs += PopCount(VoxelWord(word & ~y_before[i]));
+        runs += PopCount(VoxelWord(word & ~z_before[i]));
+        blocks[i].rows[block_rows] = word;
+      }
+      // not a lambda, which wouldn't be compiled for StatsWords' target
+      const bool last_row =
+        (z == layout.ZSize() - 1 && y == layout.YSize() - 1);
+      if(++block_rows == VoxelsPerWord || last_row) {
+        for(int i = 0; i < x_words; i++) {
+          Block &block = blocks[i];
+          std::fill(block.rows + block_rows, block.rows + VoxelsPerWord, 0);
+          VoxelWord any = 0;
+          for(VoxelWord block_row: block.rows)
+            any |= block_row;
+          if(!any)
+            continue;
+          TransposeBits(block.rows);
+          size_t *counts = stats.x_counts.data() + i * VoxelsPerWord;
+          for(int bit = 0; bit < VoxelsPerWord; bit++)
+            counts[bit] += PopCount(block.rows[bit]);
+        }
+        block_rows = 0;
+      }
+      stats.count += row_count;
+      stats.y_counts[y] += row_count;
+      stats.z_counts[z] += row_count;
+    }
+  }
+  stats.x_counts.resize(layout.XSize());
+  stats.exposed_faces = 2 * runs;
+
+  // the bounding box and centroid follow from the histograms
+  if(stats.count == 0)
+    return stats;
+  auto from_counts = [&stats](
+    const std::vector<size_t> &counts, int *min, int *max, double *centroid
+  ) {
+    *min = 0;
+    *max = int(counts.size());
+    while(counts[*min] == 0)
+      ++*min;
+    while(counts[*max - 1] == 0)
+      --*max;
+    double sum = 0;
+    for(int i = *min; i < *max; i++)
+      sum += (i + 0.5) * counts[i];
+    *centroid = sum / stats.count;
+  };
+  from_counts(stats.x_counts, &stats.min.x, &stats.max.x, &stats.centroid.x);
+  from_counts(stats.y_counts, &stats.min.y, &stats.max.y, &stats.centroid.y);
+  from_counts(stats.z_counts, &stats.min.z, &stats.max.z, &stats.centroid.z);
+  return stats;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+template<typename Layout>
+__attribute__((target("popcnt"))) BoolVoxelStats StatsWordsPopcnt(
+  const Layout &layout, const typename Layout::VoxelWord *source
+) {
+  return StatsWordsLoop(layout, source);
+}
+#endif
+
+// StatsWordsLoop, compiled for the popcnt instruction too, and run that way
+// where the CPU has it, like the VoxelKernels. Not every x86-64 CPU does, so
+// the build doesn't assume it.
+template<typename Layout>
+BoolVoxelStats StatsWords(
+  const Layout &layout, const typename Layout::VoxelWord *source
+) {
+#if defined(__x86_64__) || defined(__i386__)
+  static const bool has_popcnt = __builtin_cpu_supports("popcnt");
+  if(has_popcnt)
+    return StatsWordsPopcnt(layout, source);
+#endif
+  return StatsWordsLoop(layout, source);
+}
+
+// exposed faces /////////////////////////////////////////////////////////////
+
+/*
+Call f(x, y, z, faces) for each set voxel with a face exposed to a clear voxel
+or the outside of the volume, in z-major order, where "faces" is a mask of its
+exposed BlockFaces.
+
+As in StatsWords, the faces exposed in each direction are "word & ~neighbors"
+for a whole word of voxels at a time, where neighbors is the word shifted by
+one bit, or the same word of the next or previous row or slab. Only set bits of
+the union of the 6 masks are visited, so the interior and the empty space cost
+a few instructions per word, not per voxel.
+
+Only the voxels from "x_begin" to "x_end" - 1, "y_begin" to "y_end" - 1, and
+"z_begin" to "z_end" - 1 are visited, though their faces are exposed or not
+according to the whole volume.
+*/
+template<typename Layout, typename Func>
+void ExposedFacesWords(
+  const Layout &layout, const typename Layout::VoxelWord *source,
+  int x_begin, int x_end, int y_begin, int y_end, int z_begin, int z_end,
+  Func f
+) {
+  using VoxelWord = typename Layout::VoxelWord;
+  constexpr int VoxelsPerWord = Layout::VoxelsPerWord;
+  const VoxelWord all = VoxelWord(~VoxelWord(0));
+  const int x_words = layout.XWords();
+  const int y_stride = layout.YStride();
+  const int z_stride = layout.ZStride();
+  const typename Layout::RowBuffer zero_row = layout.MakeRowBuffer();
+  const int first_word = x_begin / VoxelsPerWord;
+  const int end_word = (x_end + VoxelsPerWord - 1) / VoxelsPerWord;
+
+  for(int z = z_begin; z < z_end; z++) {
+    for(int y = y_begin; y < y_end; y++) {
+      const VoxelWord *row = source + z * z_stride + y * y_stride;
+      const VoxelWord *y_before = (y > 0 ? row - y_stride : zero_row.data());
+      const VoxelWord *y_after =
+        (y + 1 < layout.YSize() ? row + y_stride : zero_row.data());
+      const VoxelWord *z_before = (z > 0 ? row - z_stride : zero_row.data());
+      const VoxelWord *z_after =
+        (z + 1 < layout.ZSize() ? row + z_stride : zero_row.data());
+
+      for(int i = first_word; i < end_word; i++) {
+        const VoxelWord word = row[i];
+        if(!word)
+          continue;
+        // the bits of voxels from x_begin to x_end - 1
+        VoxelWord in_range = all;
+        if(i * VoxelsPerWord < x_begin)
+          in_range &= VoxelWord(all << (x_begin - i * VoxelsPerWord));
+        if((i + 1) * VoxelsPerWord > x_end)
+          in_range &= VoxelWord(all >> ((i + 1) * VoxelsPerWord - x_end));
+        // bits shifted in from beyond the row are padding or 0, so the ends
+        // of the row are exposed
+        const VoxelWord lower = (i > 0 ? row[i-1] : 0);
+        const VoxelWord higher = (i + 1 < x_words ? row[i+1] : 0);
+        const VoxelWord x_before =
+          VoxelWord(word << 1) | VoxelWord(lower >> (VoxelsPerWord - 1));
+        const VoxelWord x_after =
+          VoxelWord(word >> 1) | VoxelWord(higher << (VoxelsPerWord - 1));
+
+        const VoxelWord x_neg = word & ~x_before;
+        const VoxelWord x_pos = word & ~x_after;
+        const VoxelWord y_neg = word & ~y_before[i];
+        const VoxelWord y_pos = word & ~y_after[i];
+        const VoxelWord z_neg = word & ~z_before[i];
+        const VoxelWord z_pos = word & ~z_after[i];
+        for(VoxelWord bits =
+              (x_neg | x_pos | y_neg | y_pos | z_neg | z_pos) & in_range;
+            bits; bits &= VoxelWord(bits - 1)) {
+          const int bit = LowestSetBit(bits);
+          const int faces =
+            int((x_neg >> bit) & 1) * XNegFace |
+            int((x_pos >> bit) & 1) * XPosFace |
+            int((y_neg >> bit) & 1) * YNegFace |
+            int((y_pos >> bit) & 1) * YPosFace |
+            int((z_neg >> bit) & 1) * ZNegFace |
+            int((z_pos >> bit) & 1) * ZPosFace;
+          f(i * VoxelsPerWord + bit, y, z, faces);
+        }
+      }
+    }
+  }
+}
+
+template<typename Layout, typename Func>
+void ExposedFacesWords(
+  const Layout &layout, const typename Layout::VoxelWord *source,
+  int z_begin, int z_end, Func f
+) {
+  ExposedFacesWords(layout, source, 0, layout.XSize(), 0, layout.YSize(),
+    z_begin, z_end, f);
+}
+
+template<typename Layout, typename Func>
+void ExposedFacesWords(
+  const Layout &layout, const typename Layout::VoxelWord *source, Func f
+) {
+  ExposedFacesWords(layout, source, 0, layout.ZSize(), f);
+}
+
+// rotations /////////////////////////////////////////////////////////////////
+
+// quarter rotation around the X-axis; every row moves whole
+template<typename Layout>
+void RotateXWords(
+  const Layout &layout,
+  const typename Layout::VoxelWord *source, typename Layout::VoxelWord *dest
+) {
+  assert(layout.YSize() == layout.ZSize());
+
+  const int y_size = layout.YSize();
+  const int y_stride = layout.YStride();
+  const int z_stride = layout.ZStride();
+  const size_t row_bytes = layout.XWords() * sizeof(*dest);
+
+  for(int z = 0; z < layout.ZSize(); z++) {
+    for(int y = 0; y < y_size; y++) {
+      memcpy(dest + y * z_stride + (y_size - 1 - z) * y_stride,
+        source + z * z_stride + y * y_stride, row_bytes);
+    }
+  }
+}
+
+// RotateYWords and RotateZWords are both a transpose of a 2D bit matrix, done
+// in blocks of VoxelsPerWord x VoxelsPerWord voxels using TransposeBits. If the
+// volume isn't a whole number of blocks across, the last block in each
+// direction reads 0 for rows beyond the edge and skips writing them. Padding
+// bits come from those rows, so they stay 0.
+
+template<typename Layout>
+void RotateYWords(
+  const Layout &layout,
+  const typename Layout::VoxelWord *source, typename Layout::VoxelWord *dest
+) {
+  using VoxelWord = typename Layout::VoxelWord;
+  constexpr int VoxelsPerWord = Layout::VoxelsPerWord;
+  assert(layout.XSize() == layout.ZSize());
+
+  // Within each XZ plane, source row z becomes destination column x = z, and
+  // source column x becomes destination row z = z_size - 1 - x.
+
+  const int x_size = layout.XSize();
+  const int z_size = layout.ZSize();
+  const int x_words = layout.XWords();
+  const int y_stride = layout.YStride();
+  const int z_stride = layout.ZStride();
+
+  VoxelWord block[VoxelsPerWord];
+  for(int y = 0; y < layout.YSize(); y++) {
+    for(int source_z_word = 0; source_z_word < x_words; source_z_word++) {
+      const int z_begin = source_z_word * VoxelsPerWord;
+      const int z_num = std::min(VoxelsPerWord, z_size - z_begin);
+      for(int source_x_word = 0; source_x_word < x_words; source_x_word++) {
+        const VoxelWord *source_column = source + y * y_stride +
+          z_begin * z_stride + source_x_word;
+        for(int i = 0; i < z_num; i++)
+          block[i] = source_column[i * z_stride];
+        std::fill(block + z_num, block + VoxelsPerWord, 0);
+
+        TransposeBits(block);
+
+        // block[i] is now destination row z = z_size - 1 - (source x), where
+        // source x = source_x_word * VoxelsPerWord + i
+        const int x_begin = source_x_word * VoxelsPerWord;
+        const int x_num = std::min(VoxelsPerWord, x_size - x_begin);
+        VoxelWord *dest_column = dest + y * y_stride + source_z_word;
+        for(int i = 0; i < x_num; i++)
+          dest_column[(z_size - 1 - x_begin - i) * z_stride] = block[i];
+      }
+    }
+  }
+}
+
+template<typename Layout>
+void RotateZWords(
+  const Layout &layout,
+  const typename Layout::VoxelWord *source, typename Layout::VoxelWord *dest
+) {
+  using VoxelWord = typename Layout::VoxelWord;
+  constexpr int VoxelsPerWord = Layout::VoxelsPerWord;
+  assert(layout.XSize() == layout.YSize());
+
+  // Within each XY plane, source row y becomes destination column
+  // x = x_size - 1 - y, and source column x becomes destination row y = x.
+
+  const int x_size = layout.XSize();
+  const int y_size = layout.YSize();
+  const int x_words = layout.XWords();
+  const int y_stride = layout.YStride();
+  const int z_stride = layout.ZStride();
+
+  VoxelWord block[VoxelsPerWord];
+  for(int z = 0; z < layout.ZSize(); z++) {
+    const VoxelWord *source_plane = source + z * z_stride;
+    VoxelWord *dest_plane = dest + z * z_stride;
+    for(int dest_x_word = 0; dest_x_word < x_words; dest_x_word++) {
+      const int x_begin = dest_x_word * VoxelsPerWord;
+      const int x_num = std::min(VoxelsPerWord, x_size - x_begin);
+      for(int dest_y_word = 0; dest_y_word < x_words; dest_y_word++) {
+        // block[i] = source row y = y_size - 1 - (dest x), where
+        // dest x = x_begin + i
+        const VoxelWord *source_column = source_plane + dest_y_word;
+        for(int i = 0; i < x_num; i++)
+          block[i] = source_column[(y_size - 1 - x_begin - i) * y_stride];
+        std::fill(block + x_num, block + VoxelsPerWord, 0);
+
+        TransposeBits(block);
+
+        const int y_begin = dest_y_word * VoxelsPerWord;
+        const int y_num = std::min(VoxelsPerWord, y_size - y_begin);
+        VoxelWord *dest_column = dest_plane + y_begin * y_stride + dest_x_word;
+        for(int i = 0; i < y_num; i++)
+          dest_column[i * y_stride] = block[i];
+      }
+    }
+  }
+}
+
+#endif
@@ -1,177 +1,272 @@
 #include "bool_voxel_volume.h"
 
+#include "block_mesh.h"
+#include "bool_voxel_ops.h"
+#include "parallel_for.h"
+
+#include <algorithm>
 #include <cassert>
-#include <cstring>
+#include <utility>
 
-BoolVoxelVolume::BoolVoxelVolume(int x_size, int y_size, int z_size) :
+template<typename Word>
+BasicBoolVoxelVolume<Word>::BasicBoolVoxelVolume(
+  int x_size, int y_size, int z_size
+) :
   VoxelVolume(x_size, y_size, z_size),
-  x_words_(x_size / VoxelsPerWord),
-  voxels_(x_size * y_size * z_size / VoxelsPerWord)
-{
-  assert(x_size % VoxelsPerWord == 0);
+  x_words_((x_size + VoxelsPerWord - 1) / VoxelsPerWord),
+  voxels_(x_words_ * y_size * z_size),
+  dirty_(x_size, y_size, z_size)
+{}
+
+template<typename Word>
+BasicBoolVoxelVolume<Word>& BasicBoolVoxelVolume<Word>::operator=(
+  const BasicBoolVoxelVolume &other
+) {
+  VoxelVolume::operator=(other);
+  x_words_ = other.x_words_;
+  voxels_ = other.voxels_;
+  dirty_ = other.dirty_;
+  dirty_.MarkAll();
+  return *this;
+}
+
+template<typename Word>
+BasicBoolVoxelVolume<Word>& BasicBoolVoxelVolume<Word>::operator=(
+  BasicBoolVoxelVolume &&other
+) {
+  VoxelVolume::operator=(other);
+  x_words_ = other.x_words_;
+  voxels_ = std::move(other.voxels_);
+  dirty_ = std::move(other.dirty_);
+  dirty_.MarkAll();
+  return *this;
 }
 
-bool BoolVoxelVolume::GetBool(int x, int y, int z) const /*override*/ {
+template<typename Word>
+bool BasicBoolVoxelVolume<Word>::GetBool(
+  int x, int y, int z
+) const /*override*/ {
   return Get(x,y,z);
 }
 
-Color BoolVoxelVolume::GetColor(int x, int y, int z) const /*override*/ {
+template<typename Word>
+Color BasicBoolVoxelVolume<Word>::GetColor(
+  int x, int y, int z
+) const /*override*/ {
   return Color::White;
 }
 
-bool BoolVoxelVolume::IsEmpty() const {
-  size_t size = voxels_.size();
-  const VoxelWord *data = voxels_.data();
-  for(size_t i = 0; i < size; i++) {
-    if(data[i])
-      return false;
+template<typename Word>
+bool BasicBoolVoxelVolume<Word>::IsEmpty() const {
+  return !KernelWordOps::AnySet(voxels_.data(), voxels_.size());
+}
+
+template<typename Word>
+TriMesh BasicBoolVoxelVolume<Word>::CreateBlockMesh(
+  BlockMeshStyle style
+) /*override*/ {
+  auto add_faces = [this](auto *builder, int z_begin, int z_end) {
+    ExposedFacesWords(Layout(), voxels_.data(), z_begin, z_end,
+      [&](int x, int y, int z, int faces) {
+        // not a virtual call
+        builder->AddFaces(
+          x, y, z, faces, BasicBoolVoxelVolume::GetColor(x,y,z));
+      });
+  };
+
+  if(style == BlockMeshStyle::Greedy) {
+    GreedyBlockMeshBuilder builder(*this);
+    add_faces(&builder, 0, z_size_);
+    return builder.TakeMesh();
   }
-  return true;
+
+  return BuildBlockMeshInSlabs(*this, ParallelThreads(),
+    [&](BlockMeshBuilder *builder, int z_begin, int z_end) {
+      // counting the faces first costs much less than growing the mesh
+      size_t face_count = 0;
+      ExposedFacesWords(Layout(), voxels_.data(), z_begin, z_end,
+        [&](int, int, int, int faces) {
+          face_count += PopCount(unsigned(faces));
+        });
+      builder->Reserve(face_count);
+      add_faces(builder, z_begin, z_end);
+    });
 }
 
-BoolVoxelVolume BoolVoxelVolume::SweepX() const {
-  const int y_stride = x_words_;
+template<typename Word>
+BasicBoolVoxelVolume<Word> BasicBoolVoxelVolume<Word>::SweepX() const {
+  BasicBoolVoxelVolume swept(x_size_, y_size_, z_size_);
+  SweepXWords<KernelWordOps>(Layout(), voxels_.data(), swept.voxels_.data());
+  return swept;
+}
 
-  BoolVoxelVolume swept(x_size_, y_size_, z_size_);
-  VoxelWord *dest_row = swept.voxels_.data();
-  const VoxelWord *source_row = voxels_.data();
+template<typename Word>
+BasicBoolVoxelVolume<Word> BasicBoolVoxelVolume<Word>::SweepY() const {
+  BasicBoolVoxelVolume swept(x_size_, y_size_, z_size_);
+  SweepYWords<KernelWordOps>(Layout(), voxels_.data(), swept.voxels_.data());
+  return swept;
+}
 
-  for(int z = 0; z < z_size_; z++) {
-    for(int y = 0; y < y_size_; y++) {
-      const VoxelWord *word = source_row;
-      for(int x = 0; x < x_words_; x++) {
-        if(*word) {
-          memset(dest_row, 0xff, x_words_ * sizeof(VoxelWord));
-          break;
-        }
-        word++;
-      }
-      dest_row += y_stride;
-      source_row += y_stride;
-    }
-  }
+template<typename Word>
+BasicBoolVoxelVolume<Word> BasicBoolVoxelVolume<Word>::SweepZ() const {
+  BasicBoolVoxelVolume swept(x_size_, y_size_, z_size_);
+  SweepZWords<KernelWordOps>(Layout(), voxels_.data(), swept.voxels_.data());
+  return swept;
+}
 
+template<typename Word>
+BasicBoolVoxelVolume<Word> BasicBoolVoxelVolume<Word>::SweepPositive(
+  Axis axis
+) const {
+  BasicBoolVoxelVolume swept(x_size_, y_size_, z_size_);
+  SweepPositiveWords<KernelWordOps>(
+    Layout(), axis, voxels_.data(), swept.voxels_.data());
   return swept;
 }
 
-BoolVoxelVolume BoolVoxelVolume::RotateX() const {
-  assert(y_size_ == z_size_);
+template<typename Word>
+BasicBoolVoxelVolume<Word> BasicBoolVoxelVolume<Word>::SweepNegative(
+  Axis axis
+) const {
+  BasicBoolVoxelVolume swept(x_size_, y_size_, z_size_);
+  SweepNegativeWords<KernelWordOps>(
+    Layout(), axis, voxels_.data(), swept.voxels_.data());
+  return swept;
+}
 
-  const int y_stride = x_words_;
-  const int z_stride = x_words_ * y_size_;
+template<typename Word>
+BasicBoolVoxelVolume<Word> BasicBoolVoxelVolume<Word>::Dilate(
+  Neighborhood neighborhood, int iterations
+) const {
+  BasicBoolVoxelVolume dilated(x_size_, y_size_, z_size_);
+  MorphologyWords(Layout(), MorphologyOp::Dilate, neighborhood, iterations,
+    voxels_.data(), dilated.voxels_.data());
+  return dilated;
+}
 
-  BoolVoxelVolume rotated(x_size_, y_size_, z_size_);
-  VoxelWord *dest_data = rotated.voxels_.data();
-  const VoxelWord *source_row = voxels_.data();
+template<typename Word>
+BasicBoolVoxelVolume<Word> BasicBoolVoxelVolume<Word>::Erode(
+  Neighborhood neighborhood, int iterations
+) const {
+  BasicBoolVoxelVolume eroded(x_size_, y_size_, z_size_);
+  MorphologyWords(Layout(), MorphologyOp::Erode, neighborhood, iterations,
+    voxels_.data(), eroded.voxels_.data());
+  return eroded;
+}
 
-  for(int z = 0; z < z_size_; z++) {
-    VoxelWord *dest_row = dest_data + (y_size_ - 1 - z) * y_stride;
-    for(int y = 0; y < y_size_; y++) {
-      memcpy(dest_row, source_row, x_words_ * sizeof(VoxelWord));
-      dest_row += z_stride;
-      source_row += y_stride;
-    }
-  }
-  return rotated;
+template<typename Word>
+BasicBoolVoxelVolume<Word> BasicBoolVoxelVolume<Word>::Open(
+  Neighborhood neighborhood, int iterations
+) const {
+  return Erode(neighborhood, iterations).Dilate(neighborhood, iterations);
 }
 
-BoolVoxelVolume BoolVoxelVolume::RotateY() const {
-  assert(x_size_ == z_size_);
+template<typename Word>
+BasicBoolVoxelVolume<Word> BasicBoolVoxelVolume<Word>::Close(
+  Neighborhood neighborhood, int iterations
+) const {
+  return Dilate(neighborhood, iterations).Erode(neighborhood, iterations);
+}
 
-  BoolVoxelVolume rotated(x_size_, y_size_, z_size_);
-  for(int z = 0; z < z_size_; z++) {
-    for(int y = 0; y < y_size_; y++) {
-      for(int x = 0; x < x_size_; x++) {
-        if(Get(x,y,z))
-          rotated.Set(z, y, z_size_ - 1 - x);
-      }
-    }
+template<typename Word>
+std::vector<BasicBoolVoxelVolume<Word>>
+BasicBoolVoxelVolume<Word>::BuildLodPyramid(LodVote vote) const {
+  int levels = 0;
+  for(int size = std::max({x_size_, y_size_, z_size_}); size > 1;
+      size = (size + 1) / 2)
+    levels++;
+  std::vector<BasicBoolVoxelVolume> pyramid;
+  pyramid.reserve(levels);
+
+  const Vector3f min = MinBound();
+  float scale = 1;
+  const BasicBoolVoxelVolume *finer = this;
+  for(int level = 0; level < levels; level++) {
+    scale *= 2;
+    BasicBoolVoxelVolume coarser((finer->x_size_ + 1) / 2,
+      (finer->y_size_ + 1) / 2, (finer->z_size_ + 1) / 2);
+    coarser.SetBounds(min, min + Vector3f {
+      VoxelXSize() * scale * coarser.x_size_,
+      VoxelYSize() * scale * coarser.y_size_,
+      VoxelZSize() * scale * coarser.z_size_});
+
+    // slabs of Z in parallel, but not so thin that starting threads costs
+    // more than the work
+    const int slabs = std::min(coarser.z_size_,
+      int(coarser.voxels_.size() / (1 << 14)) + 1);
+    ParallelFor(0, slabs, [&](int i) {
+      DownsampleWords(finer->Layout(), coarser.Layout(), vote,
+        finer->voxels_.data(), coarser.voxels_.data(),
+        SplitRange(0, coarser.z_size_, slabs, i),
+        SplitRange(0, coarser.z_size_, slabs, i + 1));
+    });
+    pyramid.push_back(std::move(coarser));
+    finer = &pyramid.back();
   }
+  return pyramid;
+}
+
+template<typename Word>
+BasicBoolVoxelVolume<Word> BasicBoolVoxelVolume<Word>::RotateX() const {
+  BasicBoolVoxelVolume rotated(x_size_, y_size_, z_size_);
+  RotateXWords(Layout(), voxels_.data(), rotated.voxels_.data());
   return rotated;
 }
 
-BoolVoxelVolume BoolVoxelVolume::RotateZ() const {
-  assert(x_size_ == y_size_);
+template<typename Word>
+BasicBoolVoxelVolume<Word> BasicBoolVoxelVolume<Word>::RotateY() const {
+  BasicBoolVoxelVolume rotated(x_size_, y_size_, z_size_);
+  RotateYWords(Layout(), voxels_.data(), rotated.voxels_.data());
+  return rotated;
+}
 
-  BoolVoxelVolume rotated(x_size_, y_size_, z_size_);
-  for(int z = 0; z < z_size_; z++) {
-    for(int y = 0; y < y_size_; y++) {
-      for(int x = 0; x < x_size_; x++) {
-        if(Get(x,y,z))
-          rotated.Set(x_size_ - 1 - y, x, z);
-      }
-    }
-  }
+template<typename Word>
+BasicBoolVoxelVolume<Word> BasicBoolVoxelVolume<Word>::RotateZ() const {
+  BasicBoolVoxelVolume rotated(x_size_, y_size_, z_size_);
+  RotateZWords(Layout(), voxels_.data(), rotated.voxels_.data());
   return rotated;
 }
 
 // c = a | b
-BoolVoxelVolume BoolVoxelVolume::Union(const BoolVoxelVolume &b) const {
-  assert(x_size_ == b.x_size_);
-  assert(y_size_ == b.y_size_);
-  assert(z_size_ == b.z_size_);
-
-  BoolVoxelVolume c(x_size_, y_size_, z_size_);
-
-  const VoxelWord *a_words = voxels_.data();
-  const VoxelWord *b_words = b.voxels_.data();
-  VoxelWord *c_words = c.voxels_.data();
-
-  size_t size = voxels_.size();
-  assert(size == b.voxels_.size());
-  assert(size == c.voxels_.size());
-
-  for(size_t i = 0; i < size; i++)
-    c_words[i] = a_words[i] | b_words[i];
-
+template<typename Word>
+BasicBoolVoxelVolume<Word> BasicBoolVoxelVolume<Word>::Union(
+  const BasicBoolVoxelVolume &b
+) const {
+  assert(SameSize(b));
+  BasicBoolVoxelVolume c(x_size_, y_size_, z_size_);
+  KernelWordOps::Or(
+    voxels_.data(), b.voxels_.data(), c.voxels_.data(), voxels_.size());
   return c;
 }
 
 // c = a & b
-BoolVoxelVolume BoolVoxelVolume::Intersect(const BoolVoxelVolume &b) const {
-  assert(x_size_ == b.x_size_);
-  assert(y_size_ == b.y_size_);
-  assert(z_size_ == b.z_size_);
-
-  BoolVoxelVolume c(x_size_, y_size_, z_size_);
-
-  const VoxelWord *a_words = voxels_.data();
-  const VoxelWord *b_words = b.voxels_.data();
-  VoxelWord *c_words = c.voxels_.data();
-
-  size_t size = voxels_.size();
-  assert(size == b.voxels_.size());
-  assert(size == c.voxels_.size());
-
-  for(size_t i = 0; i < size; i++)
-    c_words[i] = a_words[i] & b_words[i];
-
+template<typename Word>
+BasicBoolVoxelVolume<Word> BasicBoolVoxelVolume<Word>::Intersect(
+  const BasicBoolVoxelVolume &b
+) const {
+  assert(SameSize(b));
+  BasicBoolVoxelVolume c(x_size_, y_size_, z_size_);
+  KernelWordOps::And(
+    voxels_.data(), b.voxels_.data(), c.voxels_.data(), voxels_.size());
   return c;
 }
 
 // c = a & ~b
-BoolVoxelVolume BoolVoxelVolume::Subtract(const BoolVoxelVolume &b) const {
-  assert(x_size_ == b.x_size_);
-  assert(y_size_ == b.y_size_);
-  assert(z_size_ == b.z_size_);
-
-  BoolVoxelVolume c(x_size_, y_size_, z_size_);
-
-  const VoxelWord *a_words = voxels_.data();
-  const VoxelWord *b_words = b.voxels_.data();
-  VoxelWord *c_words = c.voxels_.data();
-
-  size_t size = voxels_.size();
-  assert(size == b.voxels_.size());
-  assert(size == c.voxels_.size());
-
-  for(size_t i = 0; i < size; i++)
-    c_words[i] = a_words[i] & ~b_words[i];
-
+template<typename Word>
+BasicBoolVoxelVolume<Word> BasicBoolVoxelVolume<Word>::Subtract(
+  const BasicBoolVoxelVolume &b
+) const {
+  assert(SameSize(b));
+  BasicBoolVoxelVolume c(x_size_, y_size_, z_size_);
+  KernelWordOps::AndNot(
+    voxels_.data(), b.voxels_.data(), c.voxels_.data(), voxels_.size());
   return c;
 }
 
-std::ostream& operator<<(std::ostream &out, const BoolVoxelVolume &v) {
+template<typename Word>
+std::ostream& operator<<(
+  std::ostream &out, const BasicBoolVoxelVolume<Word> &v
+) {
   const int z_size = v.XSize(), y_size = v.YSize(), x_size = v.XSize();
   out << "BoolVoxelVolume("
     << x_size << ',' << y_size << ',' << z_size << ")\n";
@@ -188,3 +283,17 @@ std::ostream& operator<<(std::ostream &out, const BoolVoxelVolume &v) {
   }
   return out;
 }
+
+template class BasicBoolVoxelVolume<uint8_t>;
+template class BasicBoolVoxelVolume<uint16_t>;
+template class BasicBoolVoxelVolume<uint32_t>;
+template class BasicBoolVoxelVolume<uint64_t>;
+
+template std::ostream& operator<<(
+  std::ostream&, const BasicBoolVoxelVolume<uint8_t>&);
+template std::ostream& operator<<(
+  std::ostream&, const BasicBoolVoxelVolume<uint16_t>&);
+template std::ostream& operator<<(
+  std::ostream&, const BasicBoolVoxelVolume<uint32_t>&);
+template std::ostream& operator<<(
+  std::ostream&, const BasicBoolVoxelVolume<uint64_t>&);
@@ -1,79 +1,198 @@
 #ifndef BOOL_VOXEL_VOLUME_H
 #define BOOL_VOXEL_VOLUME_H
 
+#include "bool_voxel_ops.h"
+#include "dirty_chunks.h"
 #include "math/util.h"
 #include "math/vector.h"
 #include "voxel_volume.h"
 
 #include <cassert>
+#include <cstdint>
+#include <limits>
 #include <ostream>
+#include <type_traits>
 #include <vector>
 
 /*
 A VoxelVolume where each voxel is a bool value.
 
-The voxels are packed into VoxelWords, 1 bit per voxel. To simplify the math,
-x_size_ must be a multiple of the number of bits per VoxelWord. That way, each
-row of x_size_ voxels fits neatly into a whole number of VoxelWords.
+The voxels are packed into VoxelWords, 1 bit per voxel. Each row of x_size_
+voxels starts at the beginning of a new VoxelWord, so a row takes
+ceil(x_size_ / VoxelsPerWord) words. If x_size_ isn't a multiple of
+VoxelsPerWord, the unused high bits of the last word in each row are padding.
+Padding bits are always 0, so whole-word operations (comparing, hashing,
+IsEmpty) don't need to mask them off.
 
 Suppose VoxelWord = uint8_t. Then VoxelsPerWord = 8; BitIndexBits = 3;
-BitIndexMask = 0b111. voxels_[0] contains voxels 0-7; voxels_[1] contains
-voxels 8-15; etc. Suppose we want voxel 20. 20 = 0b10100. The 3 least
-significant bits, 0b100, select a bit within a given uint8_t word. The other
-bits, 0b10, select a word within voxels_. So to get voxel 20, we do
-(voxels_[20 >> BitIndexBits] >> (20 & BitIndexMask)) & 1.
+BitIndexMask = 0b111. The first word of a row contains voxels 0-7; the second
+contains voxels 8-15; etc. Suppose we want voxel x = 20. 20 = 0b10100. The 3
+least significant bits, 0b100, select a bit within a given uint8_t word. The
+other bits, 0b10, select a word within the row. So to get voxel 20, we do
+(row[20 >> BitIndexBits] >> (20 & BitIndexMask)) & 1.
+
+VoxelWord may be any unsigned integer type. Wider words mean fewer iterations
+in loops over words; narrower words waste less padding on narrow volumes.
+
+The volume keeps track of which chunks of it have changed (see DirtyChunks):
+Set, Clear, and EvalInto mark the chunks they change, so that meshes and the
+like can be updated for just those.
 */
-class BoolVoxelVolume : public VoxelVolume {
+template<typename Word>
+class BasicBoolVoxelVolume : public VoxelVolume {
 public:
-  using VoxelWord = uint32_t;
+  using VoxelWord = Word;
+  static_assert(std::is_unsigned<VoxelWord>::value);
   static constexpr int VoxelsPerWord = std::numeric_limits<VoxelWord>::digits;
   static_assert(IsPowerOf2(VoxelsPerWord));
   static constexpr int BitIndexBits = Log<2>(VoxelsPerWord);
   static constexpr VoxelWord BitIndexMask = VoxelsPerWord - 1;
 
-  BoolVoxelVolume(int x_size, int y_size, int z_size);
-  virtual ~BoolVoxelVolume() {}
+  BasicBoolVoxelVolume(int x_size, int y_size, int z_size);
+  BasicBoolVoxelVolume(const BasicBoolVoxelVolume&) = default;
+  BasicBoolVoxelVolume(BasicBoolVoxelVolume&&) = default;
+  virtual ~BasicBoolVoxelVolume() {}
+
+  // Assignment may change any voxel, so it leaves every chunk dirty, rather
+  // than taking the other volume's dirty chunks.
+  BasicBoolVoxelVolume& operator=(const BasicBoolVoxelVolume &other);
+  BasicBoolVoxelVolume& operator=(BasicBoolVoxelVolume &&other);
 
   // get the voxel at the given x,y,z address (prefer this non-virtual method
   // over GetBool, when possible, for performance)
   bool Get(int x, int y, int z) const {
-    int index = VoxelIndex(x,y,z);
-    return (voxels_[index >> BitIndexBits] >> (index & BitIndexMask)) & 1;
+    return (voxels_[WordIndex(x,y,z)] >> (x & BitIndexMask)) & 1;
   }
 
   // set a voxel to 1
   void Set(int x, int y, int z) {
-    int index = VoxelIndex(x,y,z);
-    VoxelWord &word = voxels_[index >> BitIndexBits];
-    VoxelWord bit = VoxelWord(1) << (index & BitIndexMask);
+    VoxelWord &word = voxels_[WordIndex(x,y,z)];
+    VoxelWord bit = VoxelWord(1) << (x & BitIndexMask);
     word = (word & ~bit) | bit;
+    dirty_.Mark(x,y,z);
+  }
+
+  // set a voxel to 0
+  void Clear(int x, int y, int z) {
+    VoxelWord &word = voxels_[WordIndex(x,y,z)];
+    word &= VoxelWord(~(VoxelWord(1) << (x & BitIndexMask)));
+    dirty_.Mark(x,y,z);
   }
 
   bool GetBool(int x, int y, int z) const override;
   Color GetColor(int x, int y, int z) const override;
 
+  // moving the bounds moves every vertex, so it marks every chunk dirty
+  void SetBounds(const Vector3f &min, const Vector3f &max) override {
+    if(min != MinBound() || max != MaxBound())
+      dirty_.MarkAll();
+    VoxelVolume::SetBounds(min, max);
+  }
+
   bool IsEmpty() const;
 
-  const std::vector<VoxelWord>& GetVoxels() { return voxels_; }
+  // the same mesh as VoxelVolume::CreateBlockMesh, with the exposed faces
+  // found a word at a time
+  TriMesh CreateBlockMesh(
+    BlockMeshStyle style = BlockMeshStyle::Faces) override;
 
-  BoolVoxelVolume SweepX() const;
+  // count, exposed faces, bounding box, etc. in one pass; see BoolVoxelStats
+  BoolVoxelStats Stats() const { return StatsWords(Layout(), voxels_.data()); }
+
+  // size in VoxelWords of each row of x_size_ voxels, including padding
+  int XWords() const { return x_words_; }
+
+  // the valid (non-padding) bits of the last word in each row
+  VoxelWord LastWordMask() const { return Layout().LastWordMask(); }
+
+  // this volume's dimensions, for the functions in bool_voxel_ops.h
+  BoolVoxelLayout<Word> Layout() const {
+    return BoolVoxelLayout<Word>(x_size_, y_size_, z_size_);
+  }
 
-  BoolVoxelVolume RotateX() const; // quarter rotation around X-axis
-  BoolVoxelVolume RotateY() const;
-  BoolVoxelVolume RotateZ() const;
+  const std::vector<VoxelWord>& GetVoxels() const { return voxels_; }
 
-  BoolVoxelVolume Union(const BoolVoxelVolume&) const;
-  BoolVoxelVolume Intersect(const BoolVoxelVolume&) const;
-  BoolVoxelVolume Subtract(const BoolVoxelVolume&) const;
+  // raw access to the packed voxels, for bulk operations like EvalInto. the
+  // caller must leave padding bits 0, and mark the chunks it changes dirty.
+  VoxelWord* MutableVoxels() { return voxels_.data(); }
+
+  // which chunks have changed since they were last taken
+  const DirtyChunks& Dirty() const { return dirty_; }
+  DirtyChunks& Dirty() { return dirty_; }
+
+  // whether "other" has the same number of voxels in each dimension
+  bool SameSize(const BasicBoolVoxelVolume &other) const {
+    return x_size_ == other.x_size_ && y_size_ == other.y_size_ &&
+      z_size_ == other.z_size_;
+  }
+
+  // Sweep the volume along an axis: every voxel in a line parallel to that
+  // axis is set if any voxel in that line is set.
+  BasicBoolVoxelVolume SweepX() const;
+  BasicBoolVoxelVolume SweepY() const;
+  BasicBoolVoxelVolume SweepZ() const;
+
+  // Sweep in only one direction along "axis": a voxel is set if it, or any
+  // voxel before it (SweepPositive) or after it (SweepNegative) in that
+  // direction, is set. That is, each line is filled from its first (last)
+  // occupied voxel onward.
+  BasicBoolVoxelVolume SweepPositive(Axis axis) const;
+  BasicBoolVoxelVolume SweepNegative(Axis axis) const;
+
+  // Morphology, repeated "iterations" times. Dilate sets every voxel that has
+  // a set neighbor; Erode clears every voxel that has a clear neighbor, where
+  // voxels outside the volume count as clear. Open (erode, then dilate)
+  // removes specks and thin protrusions; Close (dilate, then erode) fills
+  // pinholes and thin cracks.
+  BasicBoolVoxelVolume Dilate(Neighborhood, int iterations = 1) const;
+  BasicBoolVoxelVolume Erode(Neighborhood, int iterations = 1) const;
+  BasicBoolVoxelVolume Open(Neighborhood, int iterations = 1) const;
+  BasicBoolVoxelVolume Close(Neighborhood, int iterations = 1) const;
+
+  // Levels of detail: the volume halved in each dimension, rounded up, with
+  // each voxel standing for a 2x2x2 block of the level before (see
+  // DownsampleWords), then halved again, and so on down to 1x1x1. Level i is
+  // halved i + 1 times, and has the same MinBound, with each voxel 2^(i + 1)
+  // times the size, so it may reach past MaxBound where a size was odd. This
+  // volume is read once; each level after is made from the one before, an
+  // eighth the size. Majority votes are of the level before, not of every
+  // voxel the block covers.
+  std::vector<BasicBoolVoxelVolume> BuildLodPyramid(
+    LodVote vote = LodVote::Any) const;
+
+  BasicBoolVoxelVolume RotateX() const; // quarter rotation around X-axis
+  BasicBoolVoxelVolume RotateY() const;
+  BasicBoolVoxelVolume RotateZ() const;
+
+  // See also the fused expressions in bool_voxel_expr.h. The word-level
+  // algorithms behind all these are in bool_voxel_ops.h.
+  BasicBoolVoxelVolume Union(const BasicBoolVoxelVolume&) const;
+  BasicBoolVoxelVolume Intersect(const BasicBoolVoxelVolume&) const;
+  BasicBoolVoxelVolume Subtract(const BasicBoolVoxelVolume&) const;
 
 private:
+  // given the x,y,z address of a voxel, return the index in voxels_ of the
+  // word containing it
+  int WordIndex(int x, int y, int z) const {
+    assert(x >= 0); assert(x < x_size_);
+    assert(y >= 0); assert(y < y_size_);
+    assert(z >= 0); assert(z < z_size_);
+    return (z * y_size_ + y) * x_words_ + (x >> BitIndexBits);
+  }
+
   int x_words_; // size in VoxelWords of each row of x_size_ voxels
 
   // voxels, in z-major order. 1 voxel = 1 bit. not using vector<bool> because
   // it doesn't support data()
   std::vector<VoxelWord> voxels_;
+
+  DirtyChunks dirty_;
 };
 
-std::ostream& operator<<(std::ostream&, const BoolVoxelVolume&);
+// 64-bit words halve the loop trip counts of 32-bit words on 64-bit hosts
+typedef BasicBoolVoxelVolume<uint64_t> BoolVoxelVolume;
+
+template<typename Word>
+std::ostream& operator<<(std::ostream&, const BasicBoolVoxelVolume<Word>&);
 
 #endif
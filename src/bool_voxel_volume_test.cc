@@ -0,0 +1,650 @@
+#include "bool_voxel_volume.h"
+
+#include "bit_transpose.h"
+#include "block_mesh.h"
+#include "bool_voxel_expr.h"
+
+#include "catch.h"
+#include "mesh_test_util.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// fill a volume with a reproducible random pattern
+template<typename Volume = BoolVoxelVolume>
+Volume RandomVolume(int x_size, int y_size, int z_size, int seed) {
+  Volume v(x_size, y_size, z_size);
+  std::mt19937 rng(seed);
+  for(int z = 0; z < z_size; z++) {
+    for(int y = 0; y < y_size; y++) {
+      for(int x = 0; x < x_size; x++) {
+        if(rng() & 1)
+          v.Set(x,y,z);
+      }
+    }
+  }
+  return v;
+}
+
+template<typename Volume>
+bool SameVoxels(const Volume &a, const Volume &b) {
+  if(a.XSize() != b.XSize() || a.YSize() != b.YSize() ||
+     a.ZSize() != b.ZSize())
+    return false;
+  for(int z = 0; z < a.ZSize(); z++) {
+    for(int y = 0; y < a.YSize(); y++) {
+      for(int x = 0; x < a.XSize(); x++) {
+        if(a.Get(x,y,z) != b.Get(x,y,z))
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+template<typename Word>
+void CheckTransposeBits() {
+  constexpr int Bits = std::numeric_limits<Word>::digits;
+  std::mt19937_64 rng(Bits);
+  Word rows[Bits];
+  for(Word &row: rows)
+    row = Word(rng());
+
+  Word transposed[Bits];
+  for(int i = 0; i < Bits; i++)
+    transposed[i] = rows[i];
+  TransposeBits(transposed);
+
+  for(int i = 0; i < Bits; i++) {
+    for(int j = 0; j < Bits; j++)
+      REQUIRE(((transposed[i] >> j) & 1) == ((rows[j] >> i) & 1));
+  }
+}
+
+// Sweep "v" along "axis" voxel by voxel. Each voxel is set if any voxel in
+// the same line is set: before or at it if "direction" is +1, after or at it
+// if "direction" is -1, or anywhere if "direction" is 0.
+template<typename Volume>
+Volume ReferenceSweep(const Volume &v, Axis axis, int direction) {
+  const int a = int(axis);
+  const int sizes[3] = {v.XSize(), v.YSize(), v.ZSize()};
+  Volume swept(v.XSize(), v.YSize(), v.ZSize());
+  for(int z = 0; z < v.ZSize(); z++) {
+    for(int y = 0; y < v.YSize(); y++) {
+      for(int x = 0; x < v.XSize(); x++) {
+        int p[3] = {x, y, z};
+        int begin = (direction < 0 ? p[a] : 0);
+        int end = (direction > 0 ? p[a] + 1 : sizes[a]);
+        for(int i = begin; i < end; i++) {
+          int q[3] = {x, y, z};
+          q[a] = i;
+          if(v.Get(q[0], q[1], q[2])) {
+            swept.Set(x,y,z);
+            break;
+          }
+        }
+      }
+    }
+  }
+  return swept;
+}
+
+// Dilate or erode "v" once, voxel by voxel: each voxel becomes the OR (dilate)
+// or AND (erode) of itself and its neighbors, with voxels outside the volume
+// counting as clear.
+template<typename Volume>
+Volume ReferenceMorphology(
+  const Volume &v, bool dilate, Neighborhood neighborhood
+) {
+  Volume result(v.XSize(), v.YSize(), v.ZSize());
+  for(int z = 0; z < v.ZSize(); z++) {
+    for(int y = 0; y < v.YSize(); y++) {
+      for(int x = 0; x < v.XSize(); x++) {
+        bool any = false, all = true;
+        for(int dz = -1; dz <= 1; dz++) {
+          for(int dy = -1; dy <= 1; dy++) {
+            for(int dx = -1; dx <= 1; dx++) {
+              int distance = abs(dx) + abs(dy) + abs(dz);
+              if(neighborhood == Neighborhood::Six && distance > 1)
+                continue;
+              int nx = x + dx, ny = y + dy, nz = z + dz;
+              bool set = nx >= 0 && nx < v.XSize() && ny >= 0 &&
+                ny < v.YSize() && nz >= 0 && nz < v.ZSize() &&
+                v.Get(nx, ny, nz);
+              any = any || set;
+              all = all && set;
+            }
+          }
+        }
+        if(dilate ? any : all)
+          result.Set(x,y,z);
+      }
+    }
+  }
+  return result;
+}
+
+// halve a volume voxel by voxel, setting each voxel if any, or at least 4, of
+// the voxels of its 2x2x2 block are set
+template<typename Volume>
+Volume ReferenceDownsample(const Volume &v, LodVote vote) {
+  Volume result((v.XSize() + 1) / 2, (v.YSize() + 1) / 2, (v.ZSize() + 1) / 2);
+  for(int z = 0; z < result.ZSize(); z++) {
+    for(int y = 0; y < result.YSize(); y++) {
+      for(int x = 0; x < result.XSize(); x++) {
+        int count = 0;
+        for(int dz = 0; dz < 2; dz++) {
+          for(int dy = 0; dy < 2; dy++) {
+            for(int dx = 0; dx < 2; dx++) {
+              int nx = 2 * x + dx, ny = 2 * y + dy, nz = 2 * z + dz;
+              if(nx < v.XSize() && ny < v.YSize() && nz < v.ZSize() &&
+                 v.Get(nx, ny, nz))
+                count++;
+            }
+          }
+        }
+        if(vote == LodVote::Any ? count > 0 : count >= 4)
+          result.Set(x,y,z);
+      }
+    }
+  }
+  return result;
+}
+
+// check v.Stats() against stats computed voxel by voxel, and the mesh
+template<typename Volume>
+void CheckStats(Volume &v) {
+  BoolVoxelStats stats = v.Stats();
+
+  size_t count = 0, faces = 0;
+  std::vector<size_t> x_counts(v.XSize()), y_counts(v.YSize()),
+    z_counts(v.ZSize());
+  auto get = [&v](int x, int y, int z) {
+    return x >= 0 && x < v.XSize() && y >= 0 && y < v.YSize() && z >= 0 &&
+      z < v.ZSize() && v.Get(x,y,z);
+  };
+  for(int z = 0; z < v.ZSize(); z++) {
+    for(int y = 0; y < v.YSize(); y++) {
+      for(int x = 0; x < v.XSize(); x++) {
+        if(!v.Get(x,y,z))
+          continue;
+        count++;
+        x_counts[x]++;
+        y_counts[y]++;
+        z_counts[z]++;
+        faces += !get(x-1,y,z) + !get(x+1,y,z) + !get(x,y-1,z) +
+          !get(x,y+1,z) + !get(x,y,z-1) + !get(x,y,z+1);
+      }
+    }
+  }
+  REQUIRE(stats.count == count);
+  REQUIRE(stats.exposed_faces == faces);
+  REQUIRE(stats.exposed_faces * 2 == v.CreateBlockMesh().tris.size());
+  REQUIRE(stats.x_counts == x_counts);
+  REQUIRE(stats.y_counts == y_counts);
+  REQUIRE(stats.z_counts == z_counts);
+}
+
+// whether all the padding bits at the end of each row are 0
+template<typename Volume>
+bool PaddingIsZero(const Volume &v) {
+  using VoxelWord = typename Volume::VoxelWord;
+  const auto &words = v.GetVoxels();
+  const VoxelWord padding = VoxelWord(~v.LastWordMask());
+  for(size_t i = v.XWords() - 1; i < words.size(); i += v.XWords()) {
+    if(words[i] & padding)
+      return false;
+  }
+  return true;
+}
+
+} // namespace
+
+TEST_CASE("TransposeBits") {
+  CheckTransposeBits<uint8_t>();
+  CheckTransposeBits<uint16_t>();
+  CheckTransposeBits<uint32_t>();
+  CheckTransposeBits<uint64_t>();
+}
+
+TEST_CASE("BoolVoxelVolume rotations") {
+  const int size = 64;
+  BoolVoxelVolume v = RandomVolume(size, size, size, 1);
+
+  SECTION("RotateX") {
+    BoolVoxelVolume expected(size, size, size);
+    for(int z = 0; z < size; z++)
+      for(int y = 0; y < size; y++)
+        for(int x = 0; x < size; x++)
+          if(v.Get(x,y,z)) expected.Set(x, size - 1 - z, y);
+    REQUIRE(SameVoxels(v.RotateX(), expected));
+  }
+
+  SECTION("RotateY") {
+    BoolVoxelVolume expected(size, size, size);
+    for(int z = 0; z < size; z++)
+      for(int y = 0; y < size; y++)
+        for(int x = 0; x < size; x++)
+          if(v.Get(x,y,z)) expected.Set(z, y, size - 1 - x);
+    REQUIRE(SameVoxels(v.RotateY(), expected));
+  }
+
+  SECTION("RotateZ") {
+    BoolVoxelVolume expected(size, size, size);
+    for(int z = 0; z < size; z++)
+      for(int y = 0; y < size; y++)
+        for(int x = 0; x < size; x++)
+          if(v.Get(x,y,z)) expected.Set(size - 1 - y, x, z);
+    REQUIRE(SameVoxels(v.RotateZ(), expected));
+  }
+
+  SECTION("non-cubic volumes") {
+    BoolVoxelVolume flat = RandomVolume(size, size, 32, 2);
+    BoolVoxelVolume expected_z(size, size, 32);
+    for(int z = 0; z < 32; z++)
+      for(int y = 0; y < size; y++)
+        for(int x = 0; x < size; x++)
+          if(flat.Get(x,y,z)) expected_z.Set(size - 1 - y, x, z);
+    REQUIRE(SameVoxels(flat.RotateZ(), expected_z));
+
+    BoolVoxelVolume thin = RandomVolume(size, 32, size, 3);
+    BoolVoxelVolume expected_y(size, 32, size);
+    for(int z = 0; z < size; z++)
+      for(int y = 0; y < 32; y++)
+        for(int x = 0; x < size; x++)
+          if(thin.Get(x,y,z)) expected_y.Set(z, y, size - 1 - x);
+    REQUIRE(SameVoxels(thin.RotateY(), expected_y));
+  }
+
+  SECTION("four quarter turns are the identity") {
+    REQUIRE(SameVoxels(v.RotateY().RotateY().RotateY().RotateY(), v));
+    REQUIRE(SameVoxels(v.RotateZ().RotateZ().RotateZ().RotateZ(), v));
+  }
+}
+
+TEST_CASE("BoolVoxelVolume boolean expressions") {
+  const int size = 32;
+  BoolVoxelVolume a = RandomVolume(size, size, size, 4);
+  BoolVoxelVolume b = RandomVolume(size, size, size, 5);
+  BoolVoxelVolume c = RandomVolume(size, size, size, 6);
+
+  // a | b & ~c, voxel by voxel
+  BoolVoxelVolume expected(size, size, size);
+  for(int z = 0; z < size; z++)
+    for(int y = 0; y < size; y++)
+      for(int x = 0; x < size; x++)
+        if(a.Get(x,y,z) || (b.Get(x,y,z) && !c.Get(x,y,z)))
+          expected.Set(x,y,z);
+
+  SECTION("Eval") {
+    REQUIRE(SameVoxels(Eval(a | b & ~c), expected));
+  }
+
+  SECTION("EvalInto an operand") {
+    EvalInto(a | b & ~c, &a);
+    REQUIRE(SameVoxels(a, expected));
+  }
+
+  SECTION("Union, Intersect, Subtract") {
+    REQUIRE(SameVoxels(a.Union(b.Subtract(c)), expected));
+    REQUIRE(SameVoxels(a.Intersect(b), Eval(~(~a | ~b))));
+  }
+}
+
+TEST_CASE("BoolVoxelVolume SweepX and IsEmpty") {
+  const int size = 64;
+  BoolVoxelVolume v(size, size, size);
+  REQUIRE(v.IsEmpty());
+  REQUIRE(v.SweepX().IsEmpty());
+
+  v.Set(size - 1, 2, 3);
+  v.Set(0, 5, 7);
+  REQUIRE(!v.IsEmpty());
+
+  BoolVoxelVolume swept = v.SweepX();
+  for(int z = 0; z < size; z++) {
+    for(int y = 0; y < size; y++) {
+      bool row_set = (y == 2 && z == 3) || (y == 5 && z == 7);
+      for(int x = 0; x < size; x++)
+        REQUIRE(swept.Get(x,y,z) == row_set);
+    }
+  }
+}
+
+TEST_CASE("BoolVoxelVolume sweeps along each axis") {
+  // sparse enough that lines aren't all full
+  BoolVoxelVolume v(64, 16, 8);
+  std::mt19937 rng(7);
+  for(int i = 0; i < 40; i++)
+    v.Set(rng() % 64, rng() % 16, rng() % 8);
+
+  REQUIRE(SameVoxels(v.SweepX(), ReferenceSweep(v, Axis::X, 0)));
+  REQUIRE(SameVoxels(v.SweepY(), ReferenceSweep(v, Axis::Y, 0)));
+  REQUIRE(SameVoxels(v.SweepZ(), ReferenceSweep(v, Axis::Z, 0)));
+
+  for(Axis axis: {Axis::X, Axis::Y, Axis::Z}) {
+    INFO("axis " << int(axis));
+    REQUIRE(SameVoxels(v.SweepPositive(axis), ReferenceSweep(v, axis, 1)));
+    REQUIRE(SameVoxels(v.SweepNegative(axis), ReferenceSweep(v, axis, -1)));
+  }
+}
+
+TEST_CASE("BoolVoxelVolume morphology") {
+  BoolVoxelVolume v(70, 12, 9);
+  std::mt19937 rng(9);
+  for(int i = 0; i < 150; i++)
+    v.Set(rng() % 70, rng() % 12, rng() % 9);
+  // a solid block, so erosion leaves something
+  for(int z = 2; z < 8; z++) {
+    for(int y = 1; y < 11; y++) {
+      for(int x = 55; x < 70; x++)
+        v.Set(x,y,z);
+    }
+  }
+
+  for(Neighborhood n: {Neighborhood::Six, Neighborhood::TwentySix}) {
+    INFO("neighborhood " << int(n));
+    BoolVoxelVolume dilated = ReferenceMorphology(v, true, n);
+    BoolVoxelVolume eroded = ReferenceMorphology(v, false, n);
+    REQUIRE(SameVoxels(v.Dilate(n), dilated));
+    REQUIRE(SameVoxels(v.Erode(n), eroded));
+    REQUIRE(!eroded.IsEmpty());
+
+    REQUIRE(SameVoxels(v.Dilate(n, 0), v));
+    REQUIRE(SameVoxels(v.Dilate(n, 2), ReferenceMorphology(dilated, true, n)));
+    REQUIRE(SameVoxels(
+      v.Erode(n, 3),
+      ReferenceMorphology(ReferenceMorphology(eroded, false, n), false, n)));
+    REQUIRE(SameVoxels(v.Open(n), ReferenceMorphology(eroded, true, n)));
+    REQUIRE(SameVoxels(v.Close(n), ReferenceMorphology(dilated, false, n)));
+  }
+}
+
+TEST_CASE("BoolVoxelVolume LOD pyramid") {
+  BoolVoxelVolume v = RandomVolume(150, 37, 9, 11);
+  v.SetBounds(Vector3f {-1, 0, 2}, Vector3f {2, 1, 3});
+  // a solid block, most of which survives majority votes
+  for(int z = 1; z < 9; z++) {
+    for(int y = 4; y < 30; y++) {
+      for(int x = 60; x < 140; x++)
+        v.Set(x,y,z);
+    }
+  }
+
+  for(LodVote vote: {LodVote::Any, LodVote::Majority}) {
+    INFO("vote " << int(vote));
+    std::vector<BoolVoxelVolume> pyramid = v.BuildLodPyramid(vote);
+    // 75x19x5, 38x10x3, 19x5x2, 10x3x1, 5x2x1, 3x1x1, 2x1x1, 1x1x1
+    REQUIRE(pyramid.size() == 8);
+    REQUIRE(pyramid[0].XSize() == 75);
+    REQUIRE(pyramid[0].YSize() == 19);
+    REQUIRE(pyramid[0].ZSize() == 5);
+    REQUIRE(pyramid[3].ZSize() == 1);
+    const BoolVoxelVolume *finer = &v;
+    for(const BoolVoxelVolume &level: pyramid) {
+      REQUIRE(SameVoxels(level, ReferenceDownsample(*finer, vote)));
+      REQUIRE(PaddingIsZero(level));
+      REQUIRE(level.MinBound() == v.MinBound());
+      REQUIRE(level.VoxelXSize() == Approx(2 * finer->VoxelXSize()));
+      REQUIRE(level.VoxelYSize() == Approx(2 * finer->VoxelYSize()));
+      REQUIRE(level.VoxelZSize() == Approx(2 * finer->VoxelZSize()));
+      finer = &level;
+    }
+    if(vote == LodVote::Any)
+      REQUIRE(pyramid.back().Get(0, 0, 0));
+  }
+
+  // a coarse voxel is clear only where the whole block is empty
+  BoolVoxelVolume lone(64, 64, 64);
+  lone.Set(37, 5, 62);
+  std::vector<BoolVoxelVolume> any = lone.BuildLodPyramid();
+  REQUIRE(any.size() == 6);
+  for(int i = 0; i < 6; i++) {
+    const int shift = i + 1;
+    REQUIRE(any[i].Stats().count == 1);
+    REQUIRE(any[i].Get(37 >> shift, 5 >> shift, 62 >> shift));
+  }
+  REQUIRE(lone.BuildLodPyramid(LodVote::Majority)[0].IsEmpty());
+  REQUIRE(BoolVoxelVolume(1, 1, 1).BuildLodPyramid().empty());
+}
+
+TEST_CASE("BoolVoxelVolume Stats") {
+  BoolVoxelVolume v(70, 12, 9);
+  BoolVoxelStats empty = v.Stats();
+  REQUIRE(empty.count == 0);
+  REQUIRE(empty.exposed_faces == 0);
+  REQUIRE(empty.min == Vector3<int>{0, 0, 0});
+  REQUIRE(empty.max == Vector3<int>{0, 0, 0});
+
+  v.Set(3, 4, 5);
+  BoolVoxelStats one = v.Stats();
+  REQUIRE(one.count == 1);
+  REQUIRE(one.exposed_faces == 6);
+  REQUIRE(one.min == Vector3<int>{3, 4, 5});
+  REQUIRE(one.max == Vector3<int>{4, 5, 6});
+  REQUIRE(one.centroid == Vector3d{3.5, 4.5, 5.5});
+
+  // a 2x1x1 block hides the faces where its voxels touch
+  v.Set(4, 4, 5);
+  BoolVoxelStats two = v.Stats();
+  REQUIRE(two.exposed_faces == 10);
+  REQUIRE(two.max == Vector3<int>{5, 5, 6});
+  REQUIRE(two.centroid == Vector3d{4, 4.5, 5.5});
+
+  // runs crossing word boundaries, and touching every face of the volume
+  std::mt19937 rng(10);
+  for(int i = 0; i < 400; i++)
+    v.Set(rng() % 70, rng() % 12, rng() % 9);
+  for(int x = 0; x < 70; x++)
+    v.Set(x, 0, 0);
+  for(int z = 0; z < 9; z++)
+    v.Set(69, 11, z);
+  CheckStats(v);
+  REQUIRE(v.Stats().min == Vector3<int>{0, 0, 0});
+  REQUIRE(v.Stats().max == Vector3<int>{70, 12, 9});
+}
+
+TEST_CASE("BoolVoxelVolume block mesh in slabs") {
+  // empty slices, so some slabs start or end without faces
+  const BoolVoxelVolume v = RandomVolume(21, 13, 30, 12);
+  BoolVoxelVolume gaps(v.XSize(), v.YSize(), v.ZSize());
+  for(int z = 0; z < v.ZSize(); z++) {
+    if(z == 0 || z == 7 || z == 8 || z == 16 || z == 29)
+      continue;
+    for(int y = 0; y < v.YSize(); y++) {
+      for(int x = 0; x < v.XSize(); x++) {
+        if(v.Get(x,y,z))
+          gaps.Set(x,y,z);
+      }
+    }
+  }
+
+  auto add_faces = [&](BlockMeshBuilder *builder, int z_begin, int z_end) {
+    ExposedFacesWords(gaps.Layout(), gaps.GetVoxels().data(), z_begin, z_end,
+      [&](int x, int y, int z, int faces) {
+        builder->AddFaces(x, y, z, faces, Color::White);
+      });
+  };
+  BlockMeshBuilder serial(gaps);
+  add_faces(&serial, 0, gaps.ZSize());
+  const TriMesh expected = serial.TakeMesh();
+  REQUIRE(SameMesh(gaps.CreateBlockMesh(), expected));
+  for(int slabs: {2, 3, 7, 8, 30, 50}) {
+    INFO("slabs " << slabs);
+    REQUIRE(SameMesh(BuildBlockMeshInSlabs(gaps, slabs, add_faces), expected));
+  }
+}
+
+TEST_CASE("BoolVoxelVolume greedy block mesh") {
+  // a solid box is 6 rectangles
+  BoolVoxelVolume empty(32, 32, 32);
+  BoolVoxelVolume box = Eval(~empty);
+  TriMesh mesh = box.CreateBlockMesh(BlockMeshStyle::Greedy);
+  REQUIRE(mesh.tris.size() == 12);
+  REQUIRE(mesh.verts.size() == 8);
+  REQUIRE(IsWatertight(mesh));
+  REQUIRE(NormalsMatch(mesh));
+  REQUIRE(EnclosedVolume(mesh) == Approx(8));
+
+  // A ball with a random speckle carved out of it: lots of T-junctions, and
+  // the surface touching itself along edges where voxels meet diagonally
+  const int size = 40;
+  BoolVoxelVolume ball(size, size, size);
+  ball.SetBounds(Vector3f {0, 0, 0}, Vector3f {size, size, size});
+  std::mt19937 rng(11);
+  for(int z = 0; z < size; z++) {
+    for(int y = 0; y < size; y++) {
+      for(int x = 0; x < size; x++) {
+        const int dx = x - size / 2, dy = y - size / 2, dz = z - size / 2;
+        if(dx * dx + dy * dy + dz * dz < 18 * 18 && rng() % 8)
+          ball.Set(x,y,z);
+      }
+    }
+  }
+  TriMesh faces = ball.CreateBlockMesh();
+  TriMesh greedy = ball.CreateBlockMesh(BlockMeshStyle::Greedy);
+  REQUIRE(IsWatertight(faces));
+  REQUIRE(IsWatertight(greedy));
+  REQUIRE(NormalsMatch(greedy));
+  REQUIRE(EnclosedVolume(greedy) == Approx(ball.Stats().count));
+  REQUIRE(greedy.tris.size() < faces.tris.size());
+
+  // the same mesh as the generic, voxel by voxel CreateBlockMesh
+  REQUIRE(SameMesh(greedy,
+    ball.VoxelVolume::CreateBlockMesh(BlockMeshStyle::Greedy)));
+  REQUIRE(BoolVoxelVolume(5, 6, 7).CreateBlockMesh(
+    BlockMeshStyle::Greedy).tris.empty());
+
+  // faces only merge with faces of the same color
+  class TwoColorVolume : public VoxelVolume {
+  public:
+    TwoColorVolume() : VoxelVolume(4, 2, 2) {}
+    bool GetBool(int x, int y, int z) const override { return true; }
+    Color GetColor(int x, int y, int z) const override {
+      return x < 3 ? Color::White : Color::Black;
+    }
+  } two_colors;
+  // each color is 5 rectangles, the sides where they meet not being exposed
+  TriMesh colored = two_colors.CreateBlockMesh(BlockMeshStyle::Greedy);
+  REQUIRE(colored.tris.size() == 20);
+  REQUIRE(colored.verts.size() == 12);
+  REQUIRE(IsWatertight(colored));
+  for(const Tri &tri: colored.tris) {
+    const float x = (colored.verts[tri.vert_idxs[0]].x +
+      colored.verts[tri.vert_idxs[1]].x + colored.verts[tri.vert_idxs[2]].x);
+    REQUIRE(tri.color.r == (x / 3 < 0.5f ? 1 : 0));
+  }
+}
+
+TEMPLATE_TEST_CASE("BasicBoolVoxelVolume with padded rows", "",
+  uint8_t, uint16_t, uint32_t, uint64_t
+) {
+  using Volume = BasicBoolVoxelVolume<TestType>;
+
+  // a size that isn't a multiple of any word size, and spans several words
+  // for all but uint64_t
+  const int size = 37;
+  Volume v = RandomVolume<Volume>(size, size, size, 8);
+  REQUIRE(v.XWords() ==
+    (size + Volume::VoxelsPerWord - 1) / Volume::VoxelsPerWord);
+
+  SECTION("rotations") {
+    Volume expected_x(size, size, size);
+    Volume expected_y(size, size, size);
+    Volume expected_z(size, size, size);
+    for(int z = 0; z < size; z++) {
+      for(int y = 0; y < size; y++) {
+        for(int x = 0; x < size; x++) {
+          if(v.Get(x,y,z)) {
+            expected_x.Set(x, size - 1 - z, y);
+            expected_y.Set(z, y, size - 1 - x);
+            expected_z.Set(size - 1 - y, x, z);
+          }
+        }
+      }
+    }
+    REQUIRE(SameVoxels(v.RotateX(), expected_x));
+    REQUIRE(SameVoxels(v.RotateY(), expected_y));
+    REQUIRE(SameVoxels(v.RotateZ(), expected_z));
+    REQUIRE(PaddingIsZero(v.RotateY()));
+    REQUIRE(PaddingIsZero(v.RotateZ()));
+  }
+
+  SECTION("sweeps") {
+    Volume sparse(size, 5, 3);
+    sparse.Set(0, 1, 1);
+    sparse.Set(size - 1, 2, 2);
+    sparse.Set(size / 2, 4, 0);
+
+    REQUIRE(SameVoxels(sparse.SweepX(), ReferenceSweep(sparse, Axis::X, 0)));
+    REQUIRE(PaddingIsZero(sparse.SweepX()));
+    REQUIRE(SameVoxels(sparse.SweepY(), ReferenceSweep(sparse, Axis::Y, 0)));
+    REQUIRE(SameVoxels(sparse.SweepZ(), ReferenceSweep(sparse, Axis::Z, 0)));
+    for(Axis axis: {Axis::X, Axis::Y, Axis::Z}) {
+      INFO("axis " << int(axis));
+      Volume positive = sparse.SweepPositive(axis);
+      Volume negative = sparse.SweepNegative(axis);
+      REQUIRE(SameVoxels(positive, ReferenceSweep(sparse, axis, 1)));
+      REQUIRE(SameVoxels(negative, ReferenceSweep(sparse, axis, -1)));
+      REQUIRE(PaddingIsZero(positive));
+      REQUIRE(PaddingIsZero(negative));
+    }
+  }
+
+  SECTION("morphology") {
+    for(Neighborhood n: {Neighborhood::Six, Neighborhood::TwentySix}) {
+      INFO("neighborhood " << int(n));
+      Volume dilated = v.Dilate(n);
+      REQUIRE(SameVoxels(dilated, ReferenceMorphology(v, true, n)));
+      REQUIRE(PaddingIsZero(dilated));
+      Volume expected_closed =
+        ReferenceMorphology(ReferenceMorphology(v, true, n), false, n);
+      REQUIRE(SameVoxels(v.Close(n), expected_closed));
+    }
+  }
+
+  SECTION("stats") {
+    CheckStats(v);
+    // every padding bit would be a spurious exposed face, were it set
+    Volume all = Eval(v | ~v);
+    REQUIRE(all.Stats().exposed_faces ==
+      2 * size_t(size * size + size * size + size * size));
+  }
+
+  SECTION("block mesh") {
+    // the same mesh as the generic, voxel by voxel CreateBlockMesh
+    v.SetBounds(Vector3f {-3, 0, 1}, Vector3f {4, 2, 9});
+    REQUIRE(SameMesh(v.CreateBlockMesh(), v.VoxelVolume::CreateBlockMesh()));
+    Volume all = Eval(v | ~v);
+    REQUIRE(SameMesh(all.CreateBlockMesh(),
+      all.VoxelVolume::CreateBlockMesh()));
+    REQUIRE(Volume(size, 2, 3).CreateBlockMesh().tris.empty());
+  }
+
+  SECTION("LOD pyramid") {
+    for(LodVote vote: {LodVote::Any, LodVote::Majority}) {
+      INFO("vote " << int(vote));
+      std::vector<Volume> pyramid = v.BuildLodPyramid(vote);
+      REQUIRE(pyramid.size() == 6);
+      const Volume *finer = &v;
+      for(const Volume &level: pyramid) {
+        REQUIRE(SameVoxels(level, ReferenceDownsample(*finer, vote)));
+        REQUIRE(PaddingIsZero(level));
+        finer = &level;
+      }
+    }
+  }
+
+  SECTION("complements leave padding 0") {
+    Volume all = Eval(v | ~v);
+    REQUIRE(PaddingIsZero(all));
+    REQUIRE(Eval(~all).IsEmpty());
+    REQUIRE(all.Get(size - 1, size - 1, size - 1));
+  }
+}
@@ -0,0 +1,129 @@
+#include "chunked_block_mesh.h"
+
+#include "block_mesh.h"
+#include "bool_voxel_ops.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+template<typename Word>
+ChunkedBlockMesh<Word>::ChunkedBlockMesh(BasicBoolVoxelVolume<Word> *volume) :
+  volume_(volume),
+  chunk_meshes_(volume->Dirty().Chunks()),
+  vert_begins_(Chunks() + 1, 0),
+  tri_begins_(Chunks() + 1, 0),
+  remeshed_(Chunks(), 1)
+{
+  mesh_.has_color = true;
+  volume_->Dirty().Take();
+  ParallelFor(0, Chunks(), [&](int chunk) { MeshChunk(chunk); });
+}
+
+template<typename Word>
+int ChunkedBlockMesh<Word>::Update() {
+  DirtyChunks &dirty = volume_->Dirty();
+  // the volume has been assigned one of another size
+  assert(dirty.Chunks() == Chunks());
+  const int x_chunks = dirty.XChunks();
+  const int y_chunks = dirty.YChunks();
+  const int z_chunks = dirty.ZChunks();
+
+  std::vector<uint8_t> remesh(Chunks(), 0);
+  for(int chunk: dirty.Take()) {
+    const int cx = chunk % x_chunks;
+    const int cy = (chunk / x_chunks) % y_chunks;
+    const int cz = chunk / x_chunks / y_chunks;
+    remesh[chunk] = 1;
+    if(cx > 0) remesh[dirty.ChunkIndex(cx - 1, cy, cz)] = 1;
+    if(cx + 1 < x_chunks) remesh[dirty.ChunkIndex(cx + 1, cy, cz)] = 1;
+    if(cy > 0) remesh[dirty.ChunkIndex(cx, cy - 1, cz)] = 1;
+    if(cy + 1 < y_chunks) remesh[dirty.ChunkIndex(cx, cy + 1, cz)] = 1;
+    if(cz > 0) remesh[dirty.ChunkIndex(cx, cy, cz - 1)] = 1;
+    if(cz + 1 < z_chunks) remesh[dirty.ChunkIndex(cx, cy, cz + 1)] = 1;
+  }
+  std::vector<int> chunks;
+  for(int chunk = 0; chunk < Chunks(); chunk++) {
+    if(remesh[chunk]) {
+      chunks.push_back(chunk);
+      remeshed_[chunk] = 1;
+    }
+  }
+  ParallelFor(0, int(chunks.size()), [&](int i) { MeshChunk(chunks[i]); });
+  return int(chunks.size());
+}
+
+template<typename Word>
+void ChunkedBlockMesh<Word>::MeshChunk(int chunk) {
+  const DirtyChunks &dirty = volume_->Dirty();
+  const int x_chunks = dirty.XChunks(), y_chunks = dirty.YChunks();
+  const int x_begin = (chunk % x_chunks) * DirtyChunks::XSize;
+  const int y_begin = ((chunk / x_chunks) % y_chunks) * DirtyChunks::YSize;
+  const int z_begin = (chunk / x_chunks / y_chunks) * DirtyChunks::ZSize;
+  const int x_end = std::min(x_begin + DirtyChunks::XSize, volume_->XSize());
+  const int y_end = std::min(y_begin + DirtyChunks::YSize, volume_->YSize());
+  const int z_end = std::min(z_begin + DirtyChunks::ZSize, volume_->ZSize());
+
+  BlockMeshBuilder builder(*volume_, x_begin, x_end, y_begin, y_end, z_begin);
+  ExposedFacesWords(volume_->Layout(), volume_->GetVoxels().data(),
+    x_begin, x_end, y_begin, y_end, z_begin, z_end,
+    [&](int x, int y, int z, int faces) {
+      // not a virtual call, as in BasicBoolVoxelVolume::CreateBlockMesh
+      builder.AddFaces(x, y, z, faces,
+        volume_->BasicBoolVoxelVolume<Word>::GetColor(x,y,z));
+    });
+  chunk_meshes_[chunk] = builder.TakeMesh();
+}
+
+template<typename Word>
+const TriMesh& ChunkedBlockMesh<Word>::Mesh() {
+  // each chunk's vertices follow those of the chunks before it
+  const int n = Chunks();
+  std::vector<size_t> vert_begins(n + 1, 0), tri_begins(n + 1, 0);
+  for(int i = 0; i < n; i++) {
+    vert_begins[i + 1] = vert_begins[i] + chunk_meshes_[i].verts.size();
+    tri_begins[i + 1] = tri_begins[i] + chunk_meshes_[i].tris.size();
+  }
+
+  // copy the chunks that were remeshed, or that have moved since they were
+  // last copied, leaving the rest as they are
+  std::vector<int> chunks;
+  for(int i = 0; i < n; i++) {
+    if(remeshed_[i] || vert_begins[i] != vert_begins_[i] ||
+       tri_begins[i] != tri_begins_[i])
+      chunks.push_back(i);
+  }
+  if(chunks.empty())
+    return mesh_;
+
+  // every chunk's mesh has the same 6 normals
+  if(mesh_.normals.empty())
+    mesh_.normals = chunk_meshes_[0].normals;
+  // no default constructor to resize with
+  mesh_.verts.resize(vert_begins[n]);
+  mesh_.tris.resize(tri_begins[n], Tri(0, 0, 0));
+  ParallelFor(0, int(chunks.size()), [&](int i) {
+    const int chunk = chunks[i];
+    const TriMesh &chunk_mesh = chunk_meshes_[chunk];
+    std::copy(chunk_mesh.verts.begin(), chunk_mesh.verts.end(),
+      mesh_.verts.begin() + vert_begins[chunk]);
+    const int vert_begin = int(vert_begins[chunk]);
+    Tri *out = mesh_.tris.data() + tri_begins[chunk];
+    for(const Tri &tri: chunk_mesh.tris) {
+      *out = tri;
+      for(int &vert: out->vert_idxs)
+        vert += vert_begin;
+      out++;
+    }
+  });
+  vert_begins_ = std::move(vert_begins);
+  tri_begins_ = std::move(tri_begins);
+  std::fill(remeshed_.begin(), remeshed_.end(), 0);
+  return mesh_;
+}
+
+template class ChunkedBlockMesh<uint8_t>;
+template class ChunkedBlockMesh<uint16_t>;
+template class ChunkedBlockMesh<uint32_t>;
+template class ChunkedBlockMesh<uint64_t>;
@@ -0,0 +1,61 @@
+#ifndef CHUNKED_BLOCK_MESH_H
+#define CHUNKED_BLOCK_MESH_H
+
+#include "bool_voxel_volume.h"
+#include "mesh.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+A BasicBoolVoxelVolume's block mesh, kept up to date as the volume changes by
+remeshing only the chunks of it (see DirtyChunks) that changed, rather than
+calling CreateBlockMesh on the whole volume again.
+
+Each chunk has a mesh of its own, of the exposed faces of its voxels, made as
+CreateBlockMesh makes them. Whether a face is exposed depends on the voxel on
+the other side of it, which may be in the next chunk, so a change to a chunk
+remeshes the 6 chunks that share a face with it as well. Update takes the
+chunks the volume has marked dirty, leaving them clean, so a volume should
+have only one ChunkedBlockMesh at a time. Assigning to the volume, or moving
+its bounds, leaves all of it dirty, but it must keep its size, which the
+chunks were made for.
+
+The chunks' meshes can be uploaded or drawn one by one, or combined by Mesh()
+into one TriMesh of the same surface as CreateBlockMesh's. A vertex on the
+boundary between chunks is in the mesh of each chunk it touches, so the
+combined mesh has a few more vertices than CreateBlockMesh's. The combined
+mesh is patched rather than made again: only the chunks remeshed, and those
+after them if the remeshed ones changed size, are copied into it.
+*/
+template<typename Word>
+class ChunkedBlockMesh {
+public:
+  // the meshes of every chunk of "volume", which must outlive this
+  explicit ChunkedBlockMesh(BasicBoolVoxelVolume<Word> *volume);
+
+  // Remesh the chunks that changed since the last Update, and their
+  // neighbors, and return how many chunks that was.
+  int Update();
+
+  int Chunks() const { return int(chunk_meshes_.size()); }
+  const TriMesh& ChunkMesh(int chunk) const { return chunk_meshes_[chunk]; }
+
+  // all the chunks' meshes in one, in chunk order
+  const TriMesh& Mesh();
+
+private:
+  void MeshChunk(int chunk);
+
+  BasicBoolVoxelVolume<Word> *volume_;
+  std::vector<TriMesh> chunk_meshes_;
+
+  // the combined mesh, where each chunk's vertices and triangles start, and
+  // which chunks have been remeshed since it was last patched
+  TriMesh mesh_;
+  std::vector<size_t> vert_begins_, tri_begins_;
+  std::vector<uint8_t> remeshed_;
+};
+
+#endif
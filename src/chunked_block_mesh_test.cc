@@ -0,0 +1,139 @@
+#include "chunked_block_mesh.h"
+
+#include "bool_voxel_expr.h"
+#include "catch.h"
+#include "mesh_test_util.h"
+
+#include <random>
+#include <utility>
+#include <vector>
+
+TEST_CASE("DirtyChunks of a BoolVoxelVolume") {
+  BoolVoxelVolume v(100, 40, 20);
+  DirtyChunks &dirty = v.Dirty();
+  REQUIRE(dirty.XChunks() == 2);
+  REQUIRE(dirty.YChunks() == 3);
+  REQUIRE(dirty.ZChunks() == 2);
+  // a new volume is all dirty
+  REQUIRE(dirty.Take().size() == 12);
+  REQUIRE(!dirty.AnyDirty());
+
+  v.Set(70, 3, 19);
+  v.Clear(1, 33, 0);
+  REQUIRE(dirty.Take() == std::vector<int> {dirty.ChunkIndex(0, 2, 0),
+    dirty.ChunkIndex(1, 0, 1)});
+
+  // EvalInto marks only the chunks whose voxels change
+  BoolVoxelVolume other(100, 40, 20);
+  other.Set(5, 20, 5);
+  other.Set(70, 3, 19);
+  EvalInto(v | other, &v);
+  REQUIRE(dirty.Take() == std::vector<int> {dirty.ChunkIndex(0, 1, 0)});
+  EvalInto(v | other, &v);
+  REQUIRE(!dirty.AnyDirty());
+  // complements set padding bits, which aren't changes
+  EvalInto(~~v, &v);
+  REQUIRE(!dirty.AnyDirty());
+  EvalInto(v & ~other, &v);
+  REQUIRE(dirty.Take() == std::vector<int> {dirty.ChunkIndex(0, 1, 0),
+    dirty.ChunkIndex(1, 0, 1)});
+  REQUIRE(v.IsEmpty());
+  // and a new volume is dirty all over whatever's computed into it
+  BoolVoxelVolume computed = Eval(v | other);
+  REQUIRE(computed.Dirty().Take().size() == 12);
+}
+
+TEST_CASE("ChunkedBlockMesh") {
+  // not a whole number of chunks in any direction
+  const int x_size = 150, y_size = 37, z_size = 41;
+  BoolVoxelVolume v(x_size, y_size, z_size);
+  v.SetBounds(Vector3f {-1, 0, 2}, Vector3f {2, 1, 3});
+  std::mt19937 rng(8);
+  for(int z = 0; z < z_size; z++) {
+    for(int y = 0; y < y_size; y++) {
+      for(int x = 0; x < x_size; x++) {
+        const int dx = x - 70, dy = y - 18, dz = z - 20;
+        if(dx * dx + 4 * dy * dy + 4 * dz * dz < 70 * 70 || rng() % 50 == 0)
+          v.Set(x,y,z);
+      }
+    }
+  }
+
+  ChunkedBlockMesh<uint64_t> chunked(&v);
+  REQUIRE(chunked.Chunks() == 3 * 3 * 3);
+  REQUIRE(SameSurface(chunked.Mesh(), v.CreateBlockMesh()));
+  REQUIRE(chunked.Update() == 0);
+
+  // a voxel in the middle of a chunk remeshes it and its 6 neighbors
+  v.Clear(100, 20, 24);
+  REQUIRE(chunked.Update() == 7);
+  REQUIRE(SameSurface(chunked.Mesh(), v.CreateBlockMesh()));
+
+  // at a corner of the volume, with only 3 neighbors
+  v.Set(0, 0, 0);
+  REQUIRE(chunked.Update() == 4);
+  REQUIRE(SameSurface(chunked.Mesh(), v.CreateBlockMesh()));
+
+  // voxels either side of chunk boundaries
+  for(int x: {63, 64, 127, 128}) {
+    for(int z: {15, 16, 31, 32, 40})
+      v.Clear(x, 17, z);
+  }
+  chunked.Update();
+  REQUIRE(SameSurface(chunked.Mesh(), v.CreateBlockMesh()));
+
+  // carving a box out, as CSG would
+  BoolVoxelVolume box(x_size, y_size, z_size);
+  for(int z = 10; z < 14; z++) {
+    for(int y = 5; y < 30; y++) {
+      for(int x = 20; x < 60; x++)
+        box.Set(x,y,z);
+    }
+  }
+  EvalInto(v & ~box, &v);
+  REQUIRE(chunked.Update() < chunked.Chunks());
+  REQUIRE(SameSurface(chunked.Mesh(), v.CreateBlockMesh()));
+
+  // random edits, with the combined mesh patched after only some Updates
+  for(int i = 0; i < 20; i++) {
+    const int x = rng() % x_size, y = rng() % y_size, z = rng() % z_size;
+    if(rng() % 2)
+      v.Set(x,y,z);
+    else
+      v.Clear(x,y,z);
+    chunked.Update();
+    if(i % 3 == 0)
+      REQUIRE(SameSurface(chunked.Mesh(), v.CreateBlockMesh()));
+  }
+  REQUIRE(SameSurface(chunked.Mesh(), v.CreateBlockMesh()));
+
+  // assigning another volume leaves every chunk to be remeshed, whatever
+  // the other volume's dirty chunks
+  BoolVoxelVolume other(x_size, y_size, z_size);
+  other.SetBounds(v.MinBound(), v.MaxBound());
+  other.Set(3, 3, 3);
+  other.Dirty().Take();
+  v = other;
+  REQUIRE(chunked.Update() == chunked.Chunks());
+  REQUIRE(chunked.Mesh().tris.size() == 12);
+  REQUIRE(SameSurface(chunked.Mesh(), v.CreateBlockMesh()));
+  other.Set(100, 30, 30);
+  other.Dirty().Take();
+  v = std::move(other);
+  REQUIRE(chunked.Update() == chunked.Chunks());
+  REQUIRE(chunked.Mesh().tris.size() == 24);
+  REQUIRE(SameSurface(chunked.Mesh(), v.CreateBlockMesh()));
+
+  // moving the bounds moves every vertex, but the same bounds move none
+  v.SetBounds(v.MinBound(), v.MaxBound());
+  REQUIRE(chunked.Update() == 0);
+  v.SetBounds(Vector3f {0, 0, 0}, Vector3f {3, 1, 1});
+  REQUIRE(chunked.Update() == chunked.Chunks());
+  REQUIRE(SameSurface(chunked.Mesh(), v.CreateBlockMesh()));
+
+  // each chunk's mesh is only its own voxels' faces
+  size_t tris = 0;
+  for(int chunk = 0; chunk < chunked.Chunks(); chunk++)
+    tris += chunked.ChunkMesh(chunk).tris.size();
+  REQUIRE(tris == v.CreateBlockMesh().tris.size());
+}
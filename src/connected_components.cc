@@ -0,0 +1,244 @@
+#include "connected_components.h"
+
+#include "bool_voxel_ops.h"
+#include "ohno.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+namespace {
+
+// a run of set voxels in a row, from x = begin to x = end - 1
+struct Run {
+  int begin, end;
+};
+
+// the runs in each row of one Z slab
+struct SlabRuns {
+  std::vector<Run> runs;
+  // the runs of row y are runs[row_starts[y]] to runs[row_starts[y + 1] - 1]
+  std::vector<int> row_starts;
+};
+
+// Append the runs in a row of packed voxels. A run starts at each set voxel
+// whose predecessor is clear, and ends at each clear voxel (or padding bit)
+// whose predecessor is set.
+template<typename Word>
+void AppendRowRuns(const Word *row, int x_words, std::vector<Run> *runs) {
+  constexpr int VoxelsPerWord = std::numeric_limits<Word>::digits;
+  Word carry = 0; // the previous word's highest bit, shifted down
+  int begin = 0;
+  for(int i = 0; i < x_words; i++) {
+    const Word word = row[i];
+    const Word before = Word(word << 1) | carry;
+    carry = Word(word >> (VoxelsPerWord - 1));
+
+    // starts and ends alternate, so visit them in order of position
+    Word starts = Word(word & ~before);
+    Word ends = Word(~word & before);
+    while(starts | ends) {
+      const int bit = LowestSetBit(Word(starts | ends));
+      const Word mask = Word(Word(1) << bit);
+      if(starts & mask) {
+        begin = i * VoxelsPerWord + bit;
+        starts &= Word(~mask);
+      } else {
+        runs->push_back(Run {begin, i * VoxelsPerWord + bit});
+        ends &= Word(~mask);
+      }
+    }
+  }
+  // a run reaching the end of a row with no padding
+  if(carry)
+    runs->push_back(Run {begin, x_words * VoxelsPerWord});
+}
+
+// union-find over run indices, where each root is the smallest index in its
+// set
+class RunSets {
+public:
+  explicit RunSets(size_t size) : parent_(size) {
+    for(size_t i = 0; i < size; i++)
+      parent_[i] = int32_t(i);
+  }
+
+  int32_t Find(int32_t i) {
+    while(parent_[i] != i) {
+      parent_[i] = parent_[parent_[i]]; // path halving
+      i = parent_[i];
+    }
+    return i;
+  }
+
+  void Union(int32_t a, int32_t b) {
+    a = Find(a);
+    b = Find(b);
+    if(a < b)
+      parent_[b] = a;
+    else if(b < a)
+      parent_[a] = b;
+  }
+
+private:
+  std::vector<int32_t> parent_;
+};
+
+// Union every run in "a" with the runs it touches in "b", where "a" and "b"
+// are sorted runs from neighboring rows, starting at run indices "a_first" and
+// "b_first". Runs touch if they overlap, or, if "gap" is 1, are diagonal
+// neighbors.
+void UnionTouchingRuns(
+  const Run *a, int a_num, int32_t a_first,
+  const Run *b, int b_num, int32_t b_first,
+  int gap, RunSets *sets
+) {
+  int i = 0, j = 0;
+  while(i < a_num && j < b_num) {
+    if(a[i].begin < b[j].end + gap && b[j].begin < a[i].end + gap)
+      sets->Union(a_first + i, b_first + j);
+    // whichever run ends first can't touch any later run in the other row
+    if(a[i].end < b[j].end)
+      i++;
+    else
+      j++;
+  }
+}
+
+} // namespace
+
+template<typename Word>
+ConnectedComponents LabelConnectedComponents(
+  const BasicBoolVoxelVolume<Word> &volume, Neighborhood neighborhood
+) {
+  const int x_size = volume.XSize();
+  const int y_size = volume.YSize();
+  const int z_size = volume.ZSize();
+  const int x_words = volume.XWords();
+  const Word *words = volume.GetVoxels().data();
+
+  // 1. find the runs
+  std::vector<SlabRuns> slabs(z_size);
+  ParallelFor(0, z_size, [&](int z) {
+    SlabRuns &slab = slabs[z];
+    slab.row_starts.reserve(y_size + 1);
+    for(int y = 0; y < y_size; y++) {
+      slab.row_starts.push_back(int(slab.runs.size()));
+      AppendRowRuns(words + (size_t(z) * y_size + y) * x_words, x_words,
+        &slab.runs);
+    }
+    slab.row_starts.push_back(int(slab.runs.size()));
+  });
+
+  // each slab's runs are numbered after all the runs in the slabs before it
+  std::vector<int32_t> slab_firsts(z_size + 1);
+  for(int z = 0; z < z_size; z++) {
+    const size_t first = size_t(slab_firsts[z]) + slabs[z].runs.size();
+    if(first > size_t(std::numeric_limits<int32_t>::max()))
+      throw OHNO("too many runs in volume");
+    slab_firsts[z + 1] = int32_t(first);
+  }
+
+  // 2. union touching runs. Each chunk of slabs only touches run indices
+  // within the chunk, so the chunks can't interfere.
+  const int gap = (neighborhood == Neighborhood::TwentySix ? 1 : 0);
+  RunSets sets(slab_firsts[z_size]);
+  auto union_row = [&](int y, int z, int other_y, int other_z) {
+    if(other_y < 0 || other_y >= y_size)
+      return;
+    const SlabRuns &slab = slabs[z], &other_slab = slabs[other_z];
+    const int first = slab.row_starts[y];
+    const int other_first = other_slab.row_starts[other_y];
+    UnionTouchingRuns(
+      slab.runs.data() + first, slab.row_starts[y + 1] - first,
+      slab_firsts[z] + first,
+      other_slab.runs.data() + other_first,
+      other_slab.row_starts[other_y + 1] - other_first,
+      slab_firsts[other_z] + other_first,
+      gap, &sets);
+  };
+  // union the runs of slab z with those they touch in the previous row of the
+  // slab, if "within_slab", and in slab z - 1, if "with_previous_slab"
+  auto union_slab = [&](int z, bool within_slab, bool with_previous_slab) {
+    for(int y = 0; y < y_size; y++) {
+      if(within_slab)
+        union_row(y, z, y - 1, z);
+      if(with_previous_slab) {
+        union_row(y, z, y, z - 1);
+        if(neighborhood == Neighborhood::TwentySix) {
+          union_row(y, z, y - 1, z - 1);
+          union_row(y, z, y + 1, z - 1);
+        }
+      }
+    }
+  };
+
+  const int chunks = std::min(z_size, ParallelThreads());
+  ParallelFor(0, chunks, [&](int chunk) {
+    const int z_begin = SplitRange(0, z_size, chunks, chunk);
+    const int z_end = SplitRange(0, z_size, chunks, chunk + 1);
+    for(int z = z_begin; z < z_end; z++)
+      union_slab(z, true, z > z_begin);
+  });
+  for(int chunk = 1; chunk < chunks; chunk++)
+    union_slab(SplitRange(0, z_size, chunks, chunk), false, true);
+
+  // 3. number the roots in order, which is z-major order of each component's
+  // first run, and label every run with its root's number
+  using Voxel = LabeledVoxelVolume::Voxel;
+  std::vector<Voxel> run_labels(slab_firsts[z_size]);
+  std::vector<size_t> sizes(1);
+  size_t set_voxels = 0;
+  for(int z = 0; z < z_size; z++) {
+    const std::vector<Run> &runs = slabs[z].runs;
+    for(size_t i = 0; i < runs.size(); i++) {
+      const int32_t run = slab_firsts[z] + int32_t(i);
+      const int32_t root = sets.Find(run);
+      if(root == run) {
+        if(sizes.size() > std::numeric_limits<Voxel>::max())
+          throw OHNO("too many connected components for LabeledVoxelVolume");
+        run_labels[run] = Voxel(sizes.size());
+        sizes.push_back(0);
+      } else {
+        // roots come before the rest of their sets, so this is set already
+        run_labels[run] = run_labels[root];
+      }
+      const size_t length = runs[i].end - runs[i].begin;
+      sizes[run_labels[run]] += length;
+      set_voxels += length;
+    }
+  }
+  sizes[0] = size_t(x_size) * y_size * z_size - set_voxels;
+
+  // labels as narrow as the number of components allows
+  ConnectedComponents components {
+    LabeledVoxelVolume(x_size, y_size, z_size, Voxel(sizes.size() - 1)),
+    std::move(sizes)};
+  components.labels.VisitLabels([&](auto &labels) {
+    using Label = typename std::decay_t<decltype(labels)>::value_type;
+    ParallelFor(0, z_size, [&](int z) {
+      const SlabRuns &slab = slabs[z];
+      for(int y = 0; y < y_size; y++) {
+        Label *row = labels.data() + (size_t(z) * y_size + y) * x_size;
+        for(int i = slab.row_starts[y]; i < slab.row_starts[y + 1]; i++) {
+          const Run &run = slab.runs[i];
+          std::fill(row + run.begin, row + run.end,
+            Label(run_labels[slab_firsts[z] + i]));
+        }
+      }
+    });
+  });
+  return components;
+}
+
+template ConnectedComponents LabelConnectedComponents(
+  const BasicBoolVoxelVolume<uint8_t>&, Neighborhood);
+template ConnectedComponents LabelConnectedComponents(
+  const BasicBoolVoxelVolume<uint16_t>&, Neighborhood);
+template ConnectedComponents LabelConnectedComponents(
+  const BasicBoolVoxelVolume<uint32_t>&, Neighborhood);
+template ConnectedComponents LabelConnectedComponents(
+  const BasicBoolVoxelVolume<uint64_t>&, Neighborhood);
@@ -0,0 +1,48 @@
+#ifndef CONNECTED_COMPONENTS_H
+#define CONNECTED_COMPONENTS_H
+
+#include "bool_voxel_volume.h"
+#include "labeled_voxel_volume.h"
+#include "voxel_volume.h"
+
+#include <cstddef>
+#include <vector>
+
+struct ConnectedComponents {
+  // 0 for clear voxels; 1, 2, ... for each component, numbered in z-major
+  // order of each component's first voxel
+  LabeledVoxelVolume labels;
+
+  // sizes[label] is the number of voxels with that label, so sizes[0] is the
+  // number of clear voxels
+  std::vector<size_t> sizes;
+
+  int NumComponents() const { return int(sizes.size()) - 1; }
+};
+
+/*
+Label each connected component of set voxels in "volume", where voxels are
+connected if they're in each other's "neighborhood".
+
+This is the classic two-pass labeling, done on runs of set voxels rather than
+individual voxels:
+
+1. Find the runs in each row, straight from the packed words. (parallel over
+   Z slabs)
+2. Union each run with the runs it touches in the neighboring rows before it:
+   (y - 1, z) and (y, z - 1), plus (y - 1, z - 1) and (y + 1, z - 1) for the
+   26-neighborhood. (parallel over chunks of Z slabs, then serially across
+   the chunk boundaries)
+3. Number the union-find roots, and write each run's label. (numbering is
+   serial, writing is parallel over Z slabs)
+
+The result doesn't depend on the number of threads.
+
+The labels are stored as narrow as the number of components allows. Throws
+OhNo if there are more components than LabeledVoxelVolume::Voxel can number.
+*/
+template<typename Word>
+ConnectedComponents LabelConnectedComponents(
+  const BasicBoolVoxelVolume<Word> &volume, Neighborhood neighborhood);
+
+#endif
@@ -0,0 +1,183 @@
+#include "connected_components.h"
+
+#include "ohno.h"
+
+#include "catch.h"
+
+#include <cstdlib>
+#include <initializer_list>
+#include <random>
+#include <vector>
+
+namespace {
+
+int Index(const BoolVoxelVolume &v, int x, int y, int z) {
+  return (z * v.YSize() + y) * v.XSize() + x;
+}
+
+// label components one voxel at a time with a flood fill, numbering them in
+// the same order as LabelConnectedComponents
+std::vector<int> ReferenceLabels(
+  const BoolVoxelVolume &v, Neighborhood neighborhood
+) {
+  std::vector<int> labels(v.XSize() * v.YSize() * v.ZSize());
+  int next_label = 1;
+  std::vector<int> stack;
+  for(int start = 0; start < int(labels.size()); start++) {
+    int x = start % v.XSize(), y = start / v.XSize() % v.YSize(),
+      z = start / v.XSize() / v.YSize();
+    if(!v.Get(x,y,z) || labels[start])
+      continue;
+    labels[start] = next_label;
+    stack.push_back(start);
+    while(!stack.empty()) {
+      int i = stack.back();
+      stack.pop_back();
+      int x = i % v.XSize(), y = i / v.XSize() % v.YSize(),
+        z = i / v.XSize() / v.YSize();
+      for(int dz = -1; dz <= 1; dz++) {
+        for(int dy = -1; dy <= 1; dy++) {
+          for(int dx = -1; dx <= 1; dx++) {
+            if(neighborhood == Neighborhood::Six &&
+               abs(dx) + abs(dy) + abs(dz) != 1)
+              continue;
+            int nx = x + dx, ny = y + dy, nz = z + dz;
+            if(nx < 0 || nx >= v.XSize() || ny < 0 || ny >= v.YSize() ||
+               nz < 0 || nz >= v.ZSize() || !v.Get(nx, ny, nz))
+              continue;
+            int n = Index(v, nx, ny, nz);
+            if(!labels[n]) {
+              labels[n] = next_label;
+              stack.push_back(n);
+            }
+          }
+        }
+      }
+    }
+    next_label++;
+  }
+  return labels;
+}
+
+void CheckMatchesReference(const BoolVoxelVolume &v) {
+  for(Neighborhood n: {Neighborhood::Six, Neighborhood::TwentySix}) {
+    INFO("neighborhood " << int(n));
+    ConnectedComponents components = LabelConnectedComponents(v, n);
+    std::vector<int> expected = ReferenceLabels(v, n);
+
+    std::vector<size_t> expected_sizes(1);
+    for(int z = 0; z < v.ZSize(); z++) {
+      for(int y = 0; y < v.YSize(); y++) {
+        for(int x = 0; x < v.XSize(); x++) {
+          int label = expected[Index(v, x, y, z)];
+          REQUIRE(components.labels.Get(x,y,z) == label);
+          if(label >= int(expected_sizes.size()))
+            expected_sizes.resize(label + 1);
+          expected_sizes[label]++;
+        }
+      }
+    }
+    REQUIRE(components.sizes == expected_sizes);
+  }
+}
+
+} // namespace
+
+TEST_CASE("LabelConnectedComponents matches a flood fill") {
+  SECTION("random") {
+    // dense enough for components to wind around, and to cross words and
+    // slabs
+    BoolVoxelVolume v(72, 20, 30);
+    std::mt19937 rng(11);
+    for(int z = 0; z < v.ZSize(); z++) {
+      for(int y = 0; y < v.YSize(); y++) {
+        for(int x = 0; x < v.XSize(); x++) {
+          if(rng() % 100 < 30)
+            v.Set(x,y,z);
+        }
+      }
+    }
+    CheckMatchesReference(v);
+  }
+
+  SECTION("components joined only diagonally") {
+    BoolVoxelVolume v(8, 8, 8);
+    v.Set(1, 1, 1);
+    v.Set(2, 2, 2);
+    v.Set(4, 1, 1);
+    v.Set(5, 1, 2);
+    v.Set(7, 7, 7);
+    CheckMatchesReference(v);
+    REQUIRE(LabelConnectedComponents(v, Neighborhood::Six).NumComponents() ==
+      5);
+    REQUIRE(
+      LabelConnectedComponents(v, Neighborhood::TwentySix).NumComponents() ==
+      3);
+  }
+
+  SECTION("a U shape joined in a later slab") {
+    BoolVoxelVolume v(4, 4, 6);
+    for(int z = 0; z < 6; z++) {
+      v.Set(0, 0, z);
+      v.Set(3, 3, z);
+    }
+    for(int x = 0; x < 4; x++)
+      v.Set(x, 0, 5);
+    for(int y = 0; y < 4; y++)
+      v.Set(3, y, 5);
+    CheckMatchesReference(v);
+    REQUIRE(LabelConnectedComponents(v, Neighborhood::Six).NumComponents() ==
+      1);
+  }
+
+  SECTION("empty and full") {
+    BoolVoxelVolume v(64, 3, 2);
+    ConnectedComponents empty = LabelConnectedComponents(v, Neighborhood::Six);
+    REQUIRE(empty.NumComponents() == 0);
+    REQUIRE(empty.sizes[0] == 64 * 3 * 2);
+    REQUIRE(empty.labels.IsEmpty());
+
+    for(int z = 0; z < 2; z++) {
+      for(int y = 0; y < 3; y++)
+        v.Set(0, y, z);
+    }
+    ConnectedComponents full =
+      LabelConnectedComponents(v.SweepX(), Neighborhood::Six);
+    REQUIRE(full.NumComponents() == 1);
+    REQUIRE(full.sizes[0] == 0);
+    REQUIRE(full.sizes[1] == 64 * 3 * 2);
+  }
+}
+
+TEST_CASE("LabelConnectedComponents stores labels as narrow as it can") {
+  // isolated voxels, 2 apart in every direction
+  auto make_dots = [](int x_size, int y_size, int z_size) {
+    BoolVoxelVolume v(x_size, y_size, z_size);
+    for(int z = 0; z < z_size; z += 2) {
+      for(int y = 0; y < y_size; y += 2) {
+        for(int x = 0; x < x_size; x += 2)
+          v.Set(x,y,z);
+      }
+    }
+    return v;
+  };
+
+  ConnectedComponents few =
+    LabelConnectedComponents(make_dots(8, 8, 8), Neighborhood::TwentySix);
+  REQUIRE(few.NumComponents() == 4 * 4 * 4);
+  REQUIRE(few.labels.LabelBytes() == 1);
+
+  // 48 * 48 * 24 components fit in 16 bits
+  ConnectedComponents fits =
+    LabelConnectedComponents(make_dots(96, 96, 48), Neighborhood::TwentySix);
+  REQUIRE(fits.NumComponents() == 48 * 48 * 24);
+  REQUIRE(fits.labels.LabelBytes() == 2);
+  REQUIRE(fits.sizes.back() == 1);
+
+  // 48 * 48 * 48 don't
+  ConnectedComponents many =
+    LabelConnectedComponents(make_dots(96, 96, 96), Neighborhood::TwentySix);
+  REQUIRE(many.NumComponents() == 48 * 48 * 48);
+  REQUIRE(many.labels.LabelBytes() == 4);
+  REQUIRE(many.labels.Get(94, 94, 94) == 48 * 48 * 48);
+}
@@ -0,0 +1,98 @@
+#ifndef DIRTY_CHUNKS_H
+#define DIRTY_CHUNKS_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+/*
+Which chunks of a volume have changed since they were last taken, for
+updating things made from the volume, e.g. ChunkedBlockMesh, a chunk at a
+time instead of all over again.
+
+A chunk is XSize x YSize x ZSize voxels, with the chunks at the high ends of
+a volume cut short. XSize is a whole number of any VoxelWord's voxels, so a
+row of a chunk is whole words of a BasicBoolVoxelVolume. Every chunk starts
+out dirty, since nothing has been made from it yet.
+
+Marking is a store of 1 byte, cheap enough for every Set. Like Set, it isn't
+safe for several threads at once, unless they mark different chunks.
+*/
+class DirtyChunks {
+public:
+  static constexpr int XBits = 6, YBits = 4, ZBits = 4;
+  static constexpr int XSize = 1 << XBits, YSize = 1 << YBits,
+    ZSize = 1 << ZBits;
+
+  // the chunks of a volume of x_size x y_size x z_size voxels, all dirty
+  DirtyChunks(int x_size, int y_size, int z_size) :
+    x_chunks_((x_size + XSize - 1) >> XBits),
+    y_chunks_((y_size + YSize - 1) >> YBits),
+    z_chunks_((z_size + ZSize - 1) >> ZBits),
+    dirty_(size_t(x_chunks_) * y_chunks_ * z_chunks_, Dirty)
+  {}
+
+  // number of chunks
+  int XChunks() const { return x_chunks_; }
+  int YChunks() const { return y_chunks_; }
+  int ZChunks() const { return z_chunks_; }
+  int Chunks() const { return int(dirty_.size()); }
+
+  // the index of chunk cx,cy,cz, in z-major order
+  int ChunkIndex(int cx, int cy, int cz) const {
+    assert(cx >= 0); assert(cx < x_chunks_);
+    assert(cy >= 0); assert(cy < y_chunks_);
+    assert(cz >= 0); assert(cz < z_chunks_);
+    return (cz * y_chunks_ + cy) * x_chunks_ + cx;
+  }
+
+  // mark the chunk containing voxel x,y,z
+  void Mark(int x, int y, int z) {
+    dirty_[ChunkIndex(x >> XBits, y >> YBits, z >> ZBits)] = Dirty;
+  }
+
+  void MarkChunk(int cx, int cy, int cz) {
+    dirty_[ChunkIndex(cx, cy, cz)] = Dirty;
+  }
+
+  void MarkAll() { std::fill(dirty_.begin(), dirty_.end(), Dirty); }
+
+  bool IsDirty(int cx, int cy, int cz) const {
+    return dirty_[ChunkIndex(cx, cy, cz)] == Dirty;
+  }
+
+  // whether every chunk of the slab of chunks at "cz" is dirty
+  bool IsSlabDirty(int cz) const {
+    auto slab = dirty_.begin() + size_t(cz) * x_chunks_ * y_chunks_;
+    return std::all_of(slab, slab + size_t(x_chunks_) * y_chunks_,
+      [](State state) { return state == Dirty; });
+  }
+
+  bool AnyDirty() const {
+    return std::find(dirty_.begin(), dirty_.end(), Dirty) != dirty_.end();
+  }
+
+  // the indices of the dirty chunks, in order, leaving every chunk clean
+  std::vector<int> Take() {
+    std::vector<int> chunks;
+    for(int i = 0; i < int(dirty_.size()); i++) {
+      if(dirty_[i] == Dirty) {
+        chunks.push_back(i);
+        dirty_[i] = Clean;
+      }
+    }
+    return chunks;
+  }
+
+private:
+  // A byte each rather than std::vector<bool>, so marking is a plain store,
+  // but not a char type: stores through those may alias anything, so loops
+  // that Set voxels would have to reload the volume's pointers after each.
+  enum State : uint8_t { Clean, Dirty };
+
+  int x_chunks_, y_chunks_, z_chunks_;
+  std::vector<State> dirty_;
+};
+
+#endif
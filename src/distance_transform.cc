@@ -0,0 +1,166 @@
+#include "distance_transform.h"
+
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace {
+
+constexpr float Infinity = std::numeric_limits<float>::infinity();
+
+// scratch space for SquaredDistance1D on lines of up to "size" samples
+class LineBuffers {
+public:
+  explicit LineBuffers(int size) :
+    f(size), d(size), sites(size), bounds(size + 1) {}
+
+  std::vector<float> f, d; // input and output
+  std::vector<int> sites;
+  std::vector<float> bounds;
+};
+
+/*
+Felzenszwalb and Huttenlocher's 1D squared distance transform:
+
+  d[p] = min over q of (spacing * (p - q))^2 + f[q]
+
+computed as the lower envelope of the parabolas rooted at each q. "sites"
+holds the q of each parabola in the envelope, and parabola k is the lowest
+between bounds[k] and bounds[k+1]. Samples where f is infinite have no
+parabola; if all are, d is all infinite.
+*/
+void SquaredDistance1D(int n, float spacing, LineBuffers *buffers) {
+  const float *f = buffers->f.data();
+  float *d = buffers->d.data();
+  int *sites = buffers->sites.data();
+  float *bounds = buffers->bounds.data();
+  const double spacing2 = double(spacing) * spacing;
+
+  // where the parabolas rooted at q and r (in the envelope) intersect
+  auto intersect = [=](int q, int r) {
+    return float(
+      ((f[q] + spacing2 * q * q) - (f[r] + spacing2 * r * r)) /
+      (2 * spacing2 * (q - r)));
+  };
+
+  int k = -1;
+  for(int q = 0; q < n; q++) {
+    if(f[q] == Infinity)
+      continue;
+    if(k < 0) {
+      k = 0;
+    } else {
+      float s = intersect(q, sites[k]);
+      while(s <= bounds[k]) {
+        k--;
+        s = intersect(q, sites[k]);
+      }
+      k++;
+      bounds[k] = s;
+    }
+    sites[k] = q;
+    if(k == 0)
+      bounds[0] = -Infinity;
+    bounds[k + 1] = Infinity;
+  }
+
+  if(k < 0) {
+    std::fill(d, d + n, Infinity);
+    return;
+  }
+  k = 0;
+  for(int q = 0; q < n; q++) {
+    while(bounds[k + 1] < q)
+      k++;
+    const double offset = spacing * double(q - sites[k]);
+    d[q] = float(offset * offset + f[sites[k]]);
+  }
+}
+
+// the squared distance from each voxel to the nearest voxel whose value is
+// "target", in z-major order
+template<typename Word>
+std::vector<float> SquaredDistanceTo(
+  const BasicBoolVoxelVolume<Word> &volume, bool target
+) {
+  const int x_size = volume.XSize();
+  const int y_size = volume.YSize();
+  const int z_size = volume.ZSize();
+  const int y_stride = x_size;
+  const int z_stride = x_size * y_size;
+  std::vector<float> distances(size_t(z_stride) * z_size);
+  float *out = distances.data();
+
+  // X: straight from the voxels
+  ParallelFor(0, z_size, [&](int z) {
+    LineBuffers buffers(x_size);
+    for(int y = 0; y < y_size; y++) {
+      for(int x = 0; x < x_size; x++)
+        buffers.f[x] = (volume.Get(x,y,z) == target ? 0 : Infinity);
+      SquaredDistance1D(x_size, volume.VoxelXSize(), &buffers);
+      std::copy(buffers.d.begin(), buffers.d.end(),
+        out + z * z_stride + y * y_stride);
+    }
+  });
+
+  // Y: each column of each Z slab
+  ParallelFor(0, z_size, [&](int z) {
+    LineBuffers buffers(y_size);
+    for(int x = 0; x < x_size; x++) {
+      float *column = out + z * z_stride + x;
+      for(int y = 0; y < y_size; y++)
+        buffers.f[y] = column[y * y_stride];
+      SquaredDistance1D(y_size, volume.VoxelYSize(), &buffers);
+      for(int y = 0; y < y_size; y++)
+        column[y * y_stride] = buffers.d[y];
+    }
+  });
+
+  // Z: each column of each XZ plane
+  ParallelFor(0, y_size, [&](int y) {
+    LineBuffers buffers(z_size);
+    for(int x = 0; x < x_size; x++) {
+      float *column = out + y * y_stride + x;
+      for(int z = 0; z < z_size; z++)
+        buffers.f[z] = column[z * z_stride];
+      SquaredDistance1D(z_size, volume.VoxelZSize(), &buffers);
+      for(int z = 0; z < z_size; z++)
+        column[z * z_stride] = buffers.d[z];
+    }
+  });
+
+  return distances;
+}
+
+} // namespace
+
+template<typename Word>
+FloatVoxelVolume SignedDistanceField(const BasicBoolVoxelVolume<Word> &volume) {
+  // each voxel is 0 in one of these, so their difference is the signed
+  // distance
+  const std::vector<float> outside = SquaredDistanceTo(volume, true);
+  const std::vector<float> inside = SquaredDistanceTo(volume, false);
+
+  FloatVoxelVolume field(volume.XSize(), volume.YSize(), volume.ZSize());
+  field.SetBounds(volume.MinBound(), volume.MaxBound());
+  float *out = field.MutableVoxels();
+  const int z_stride = volume.XSize() * volume.YSize();
+  ParallelFor(0, volume.ZSize(), [&](int z) {
+    for(int i = z * z_stride; i < (z + 1) * z_stride; i++)
+      out[i] = std::sqrt(outside[i]) - std::sqrt(inside[i]);
+  });
+  return field;
+}
+
+template FloatVoxelVolume SignedDistanceField(
+  const BasicBoolVoxelVolume<uint8_t>&);
+template FloatVoxelVolume SignedDistanceField(
+  const BasicBoolVoxelVolume<uint16_t>&);
+template FloatVoxelVolume SignedDistanceField(
+  const BasicBoolVoxelVolume<uint32_t>&);
+template FloatVoxelVolume SignedDistanceField(
+  const BasicBoolVoxelVolume<uint64_t>&);
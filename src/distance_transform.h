@@ -0,0 +1,27 @@
+#ifndef DISTANCE_TRANSFORM_H
+#define DISTANCE_TRANSFORM_H
+
+#include "bool_voxel_volume.h"
+#include "float_voxel_volume.h"
+
+/*
+The exact signed Euclidean distance field of "volume".
+
+Each voxel of the result is the distance from its center to the center of the
+nearest voxel of the opposite kind, in the units of "volume"'s bounds (so
+non-cubic voxels are handled): positive for clear voxels (outside), negative
+for set voxels (inside). The surface is where the field crosses 0, halfway
+between adjacent inside and outside voxels. If "volume" is all clear (or all
+set) every voxel is +infinity (or -infinity). The result has the same
+dimensions and bounds as "volume".
+
+This is the separable algorithm of Felzenszwalb and Huttenlocher, "Distance
+Transforms of Sampled Functions": a 1D squared distance transform along every
+row in X, then every column of that result in Y, then in Z, for O(N^3) work
+in total. The lines of each pass are independent, so each pass runs in
+parallel over Z slabs (X and Y passes) or XZ planes (Z pass).
+*/
+template<typename Word>
+FloatVoxelVolume SignedDistanceField(const BasicBoolVoxelVolume<Word> &volume);
+
+#endif
@@ -0,0 +1,81 @@
+#include "distance_transform.h"
+
+#include "catch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace {
+
+// the signed distance field by brute force: compare every pair of voxels
+FloatVoxelVolume ReferenceField(const BoolVoxelVolume &v) {
+  FloatVoxelVolume field(v.XSize(), v.YSize(), v.ZSize());
+  for(int z = 0; z < v.ZSize(); z++) {
+    for(int y = 0; y < v.YSize(); y++) {
+      for(int x = 0; x < v.XSize(); x++) {
+        const bool inside = v.Get(x,y,z);
+        const Vector3f center = v.CenterOf(x,y,z);
+        float nearest = std::numeric_limits<float>::infinity();
+        for(int z2 = 0; z2 < v.ZSize(); z2++) {
+          for(int y2 = 0; y2 < v.YSize(); y2++) {
+            for(int x2 = 0; x2 < v.XSize(); x2++) {
+              if(v.Get(x2,y2,z2) == inside)
+                continue;
+              float distance = (v.CenterOf(x2,y2,z2) - center).len();
+              nearest = std::min(nearest, distance);
+            }
+          }
+        }
+        field.Set(x, y, z, inside ? -nearest : nearest);
+      }
+    }
+  }
+  return field;
+}
+
+} // namespace
+
+TEST_CASE("SignedDistanceField matches brute force") {
+  // non-cubic voxels, and a mix of blobs and specks
+  BoolVoxelVolume v(13, 9, 11);
+  v.SetBounds(Vector3f {-1, -2, 0}, Vector3f {2, 1, 4});
+  std::mt19937 rng(12);
+  for(int i = 0; i < 25; i++)
+    v.Set(rng() % 13, rng() % 9, rng() % 11);
+  for(int z = 3; z < 8; z++) {
+    for(int y = 2; y < 7; y++) {
+      for(int x = 4; x < 12; x++)
+        v.Set(x,y,z);
+    }
+  }
+
+  FloatVoxelVolume field = SignedDistanceField(v);
+  FloatVoxelVolume expected = ReferenceField(v);
+  REQUIRE(field.MinBound() == v.MinBound());
+  REQUIRE(field.MaxBound() == v.MaxBound());
+  for(int z = 0; z < v.ZSize(); z++) {
+    for(int y = 0; y < v.YSize(); y++) {
+      for(int x = 0; x < v.XSize(); x++) {
+        INFO(x << ',' << y << ',' << z);
+        REQUIRE(field.Get(x,y,z) == Approx(expected.Get(x,y,z)).epsilon(1e-5));
+        REQUIRE(field.GetBool(x,y,z) == v.Get(x,y,z));
+      }
+    }
+  }
+}
+
+TEST_CASE("SignedDistanceField of a single voxel and of empty volumes") {
+  BoolVoxelVolume v(8, 8, 8);
+  FloatVoxelVolume empty = SignedDistanceField(v);
+  REQUIRE(empty.Get(3, 4, 5) == std::numeric_limits<float>::infinity());
+
+  // default bounds are -1..1, so each voxel is 0.25 across
+  v.Set(2, 3, 4);
+  FloatVoxelVolume field = SignedDistanceField(v);
+  REQUIRE(field.Get(2, 3, 4) == Approx(-0.25f));
+  REQUIRE(field.Get(3, 3, 4) == Approx(0.25f));
+  REQUIRE(field.Get(2, 3, 7) == Approx(0.75f));
+  REQUIRE(field.Get(5, 7, 4) == Approx(0.25f * 5)); // a 3-4-5 triangle
+}
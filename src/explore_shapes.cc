@@ -12,11 +12,22 @@
 
 namespace {
 
-const int VolumeSize = 32;
 const int MaxRounds = 6;
 
 enum class UnaryOp {
   SweepX,
+  SweepY,
+  SweepZ,
+  SweepPositiveX,
+  SweepPositiveY,
+  SweepPositiveZ,
+  SweepNegativeX,
+  SweepNegativeY,
+  SweepNegativeZ,
+  Dilate,
+  Erode,
+  Open,
+  Close,
   RotateX,
   RotateY,
   RotateZ,
@@ -28,8 +39,12 @@ enum class BinaryOp {
   Subtract,
 };
 
+// The one-directional sweeps and the morphology ops are left out, since each
+// multiplies the number of shapes found per round.
 std::vector<UnaryOp> IterableUnaryOps = {
   UnaryOp::SweepX,
+  UnaryOp::SweepY,
+  UnaryOp::SweepZ,
   UnaryOp::RotateX,
   UnaryOp::RotateY,
   UnaryOp::RotateZ,
@@ -41,10 +56,34 @@ std::vector<BinaryOp> IterableBinaryOps = {
   BinaryOp::Subtract
 };
 
-BoolVoxelVolume DoUnaryOp(UnaryOp op, const BoolVoxelVolume &voxels) {
+ShapeVoxels DoUnaryOp(UnaryOp op, const ShapeVoxels &voxels) {
   switch(op) {
   case UnaryOp::SweepX:
     return voxels.SweepX();
+  case UnaryOp::SweepY:
+    return voxels.SweepY();
+  case UnaryOp::SweepZ:
+    return voxels.SweepZ();
+  case UnaryOp::SweepPositiveX:
+    return voxels.SweepPositive(Axis::X);
+  case UnaryOp::SweepPositiveY:
+    return voxels.SweepPositive(Axis::Y);
+  case UnaryOp::SweepPositiveZ:
+    return voxels.SweepPositive(Axis::Z);
+  case UnaryOp::SweepNegativeX:
+    return voxels.SweepNegative(Axis::X);
+  case UnaryOp::SweepNegativeY:
+    return voxels.SweepNegative(Axis::Y);
+  case UnaryOp::SweepNegativeZ:
+    return voxels.SweepNegative(Axis::Z);
+  case UnaryOp::Dilate:
+    return voxels.Dilate(Neighborhood::Six);
+  case UnaryOp::Erode:
+    return voxels.Erode(Neighborhood::Six);
+  case UnaryOp::Open:
+    return voxels.Open(Neighborhood::Six);
+  case UnaryOp::Close:
+    return voxels.Close(Neighborhood::Six);
   case UnaryOp::RotateX:
     return voxels.RotateX();
   case UnaryOp::RotateY:
@@ -57,8 +96,8 @@ BoolVoxelVolume DoUnaryOp(UnaryOp op, const BoolVoxelVolume &voxels) {
   }
 }
 
-BoolVoxelVolume DoBinaryOp(
-  BinaryOp op, const BoolVoxelVolume &a, const BoolVoxelVolume &b
+ShapeVoxels DoBinaryOp(
+  BinaryOp op, const ShapeVoxels &a, const ShapeVoxels &b
 ) {
   switch(op) {
   case BinaryOp::Union:
@@ -76,10 +115,10 @@ BoolVoxelVolume DoBinaryOp(
 } // namespace
 
 size_t ShapeHasher::operator()(const std::unique_ptr<Shape> &shape) const {
-  using VoxelWord = BoolVoxelVolume::VoxelWord;
+  using VoxelWord = ShapeVoxels::VoxelWord;
   uint64_t hash;
   if(!shape->have_hash) {
-    const std::vector<VoxelWord> &voxels = shape->voxels.GetVoxels();
+    const ShapeVoxels::Voxels &voxels = shape->voxels.GetVoxels();
     hash = XXH64(voxels.data(), voxels.size() * sizeof(VoxelWord), 0);
     shape->hash = hash;
     shape->have_hash = true;
@@ -93,22 +132,24 @@ size_t ShapeComparator::operator()(
   const std::unique_ptr<Shape> &a,
   const std::unique_ptr<Shape> &b) const
 {
-  using VoxelWord = BoolVoxelVolume::VoxelWord;
-  const std::vector<VoxelWord> &a_voxels = a->voxels.GetVoxels();
-  const std::vector<VoxelWord> &b_voxels = b->voxels.GetVoxels();
-  size_t a_size = a_voxels.size();
-  assert(a_size == b_voxels.size());
+  using VoxelWord = ShapeVoxels::VoxelWord;
+  const ShapeVoxels::Voxels &a_voxels = a->voxels.GetVoxels();
+  const ShapeVoxels::Voxels &b_voxels = b->voxels.GetVoxels();
   const VoxelWord *a_data = a_voxels.data();
   const VoxelWord *b_data = b_voxels.data();
-  return memcmp(a_data, b_data, a_size * sizeof(VoxelWord)) == 0;
+  return memcmp(a_data, b_data, a_voxels.size() * sizeof(VoxelWord)) == 0;
 }
 
-BoolVoxelVolume MakeSphere() {
-  BoolVoxelVolume voxels(VolumeSize, VolumeSize, VolumeSize);
-  for(int z = 0; z < VolumeSize; z++) {
-    for(int y = 0; y < VolumeSize; y++) {
-      for(int x = 0; x < VolumeSize; x++) {
-        Vector3f v = voxels.CenterOf(x, y, z);
+ShapeVoxels MakeSphere() {
+  // ShapeVoxels has no bounds; place its voxels' centers in [-1, 1] as a
+  // VoxelVolume's would be by default
+  auto center = [](int i) { return -1 + (i + 0.5f) * 2 / ShapeVolumeSize; };
+
+  ShapeVoxels voxels;
+  for(int z = 0; z < ShapeVolumeSize; z++) {
+    for(int y = 0; y < ShapeVolumeSize; y++) {
+      for(int x = 0; x < ShapeVolumeSize; x++) {
+        Vector3f v {center(x), center(y), center(z)};
         if(v.x * v.x + v.y * v.y + v.z * v.z <= 1)
           voxels.Set(x,y,z);
       }
@@ -118,70 +159,79 @@ BoolVoxelVolume MakeSphere() {
 }
 
 TriMesh ExploreShapes() {
-  ShapeSet shapes;
-  ShapeSet new_shapes;
-
-  shapes.insert(std::unique_ptr<Shape>(
+  // Each round applies the ops to the shapes found in the round before, the
+  // frontier, and pairs them with every shape found so far. A unary op on an
+  // older shape, or a binary op on 2 older shapes, was already applied in an
+  // earlier round, so the same shapes are found for a fraction of the ops.
+  ShapeSet shapes;     // found before the last round
+  ShapeSet frontier;   // found in the last round
+  ShapeSet new_shapes; // found in this round
+
+  frontier.insert(std::unique_ptr<Shape>(
     new Shape(MakeSphere(), 0)
   ));
 
   int rounds = 0;
   int repeats = 0;
 
+  auto add_shape = [&](std::unique_ptr<Shape> new_shape) {
+    if(new_shape->voxels.IsEmpty())
+      return;
+
+    bool unique = (shapes.find(new_shape) == shapes.end() &&
+      frontier.find(new_shape) == frontier.end());
+    if(unique)
+      unique = new_shapes.insert(std::move(new_shape)).second;
+    if(!unique)
+      repeats++;
+  };
+  auto add_binary_op = [&](BinaryOp op, const Shape &a, const Shape &b) {
+    add_shape(std::unique_ptr<Shape>(
+      new Shape(
+        DoBinaryOp(op, a.voxels, b.voxels),
+        std::max(a.generation, b.generation) + 1
+      )
+    ));
+  };
+
   while(rounds < MaxRounds) {
     std::cout << "\nstart round " << rounds << '\n';
     PrintingScopedTimer round_timer(
       std::string("end round ") + std::to_string(rounds));
 
-    for(const auto &shape: shapes) {
+    for(const auto &shape: frontier) {
       for(auto op: IterableUnaryOps) {
-        std::unique_ptr<Shape> new_shape(
+        add_shape(std::unique_ptr<Shape>(
           new Shape(DoUnaryOp(op, shape->voxels), shape->generation + 1)
-        );
-
-        if(new_shape->voxels.IsEmpty())
-          continue;
-
-        bool unique = (shapes.find(new_shape) == shapes.end());
-        if(unique)
-          unique = new_shapes.insert(std::move(new_shape)).second;
-        if(!unique)
-          repeats++;
+        ));
       }
       for(auto op: IterableBinaryOps) {
+        // both orders of each pair of frontier shapes, since the outer loop
+        // comes to each of them
+        for(const auto &shape2: frontier) {
+          if(shape.get() != shape2.get())
+            add_binary_op(op, *shape, *shape2);
+        }
         for(const auto &shape2: shapes) {
-          if(shape.get() == shape2.get())
-            continue;
-
-          std::unique_ptr<Shape> new_shape(
-            new Shape(
-              DoBinaryOp(op, shape->voxels, shape2->voxels),
-              std::max(shape->generation, shape2->generation) + 1
-            )
-          );
-
-          if(new_shape->voxels.IsEmpty())
-            continue;
-
-          bool unique = (shapes.find(new_shape) == shapes.end());
-          if(unique)
-            unique = new_shapes.insert(std::move(new_shape)).second;
-          if(!unique)
-            repeats++;
+          add_binary_op(op, *shape, *shape2);
+          add_binary_op(op, *shape2, *shape);
         }
       }
     }
     if(new_shapes.size() > 0) {
-      shapes.merge(new_shapes);
-      new_shapes.clear();
+      shapes.merge(frontier);
+      frontier.clear();
+      frontier.swap(new_shapes);
     } else {
       break;
     }
     rounds++;
 
-    std::cout << "size=" << shapes.size() << ", repeats=" << repeats << '\n';
+    std::cout << "size=" << shapes.size() + frontier.size()
+      << ", repeats=" << repeats << '\n';
     PrintMemoryUsage();
   }
+  shapes.merge(frontier);
 
   std::cout << "ExploreShapes size=" << shapes.size()
     << " rounds=" << rounds << " repeats=" << repeats << '\n';
@@ -194,18 +244,24 @@ TriMesh ExploreShapes() {
   {
     PrintingScopedTimer mesh_timer("ExploreShapes mesh");
 
-    combined_mesh.verts.reserve(100000000);
+    // CreateBlockMesh makes 2 triangles, and at most 4 new vertices, per
+    // exposed face, so Stats() bounds the mesh size without building it
+    size_t total_faces = 0;
+    for(const auto &shape: shapes)
+      total_faces += shape->voxels.Stats().exposed_faces;
+    combined_mesh.verts.reserve(4 * total_faces);
     combined_mesh.normals.reserve(10000);
-    combined_mesh.tris.reserve(100000000);
+    combined_mesh.tris.reserve(2 * total_faces);
 
     int generation_counts[MaxRounds+1] = {};
     Matrix4x4f mesh_offset = Identity_Matrix4x4f;
     for(auto shape = shapes.begin(); shape != shapes.end(); ++shape) {
-      //TriMesh shape_mesh = (*shape)->voxels.CreateBlockMesh();
+      //TriMesh shape_mesh =
+      //  (*shape)->voxels.ToBoolVoxelVolume().CreateBlockMesh();
       TriMesh shape_mesh;
       {
         AccumulatingScopedTimer block_timer(block_timer_accumulator);
-        shape_mesh = (*shape)->voxels.CreateBlockMesh();
+        shape_mesh = (*shape)->voxels.ToBoolVoxelVolume().CreateBlockMesh();
       }
       int generation = (*shape)->generation;
       assert(generation <= MaxRounds);
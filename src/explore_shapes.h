@@ -2,11 +2,19 @@
 #define EXPLORE_SHAPES_H
 
 #include "mesh.h"
-#include "bool_voxel_volume.h"
+#include "fixed_bool_voxel_volume.h"
 
 #include <memory>
 #include <unordered_set>
 
+// ExploreShapes' volumes are 32 voxels across, so 32-bit words fit them
+// exactly. The size is fixed at compile time so each Shape holds its voxels
+// inline.
+constexpr int ShapeVolumeSize = 32;
+typedef FixedBoolVoxelVolume<
+  ShapeVolumeSize, ShapeVolumeSize, ShapeVolumeSize, uint32_t>
+  ShapeVoxels;
+
 class Shape {
 public:
   /*
@@ -19,9 +27,9 @@ public:
   }
   */
 
-  Shape(BoolVoxelVolume &&voxels, int generation) :
+  Shape(ShapeVoxels &&voxels, int generation) :
     voxels(voxels), hash(0), have_hash(false), generation(generation) {}
-  BoolVoxelVolume voxels;
+  ShapeVoxels voxels;
   uint64_t hash;
   bool have_hash;
   int generation;
@@ -0,0 +1,191 @@
+#ifndef FIXED_BOOL_VOXEL_VOLUME_H
+#define FIXED_BOOL_VOXEL_VOLUME_H
+
+#include "bool_voxel_ops.h"
+#include "bool_voxel_volume.h"
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+/*
+A bool voxel volume whose dimensions are compile-time constants.
+
+The voxels are packed exactly as in BasicBoolVoxelVolume, but stored inline in
+a std::array instead of a heap-allocated vector, and every stride is constexpr.
+There is no VoxelVolume base class, so no vtable and no float bounds. The
+volume occupies only its voxels. That makes it cheap to hold millions of them,
+and lets the compiler unroll and vectorize the loops in bool_voxel_ops.h.
+
+To mesh a FixedBoolVoxelVolume, or use it anywhere a VoxelVolume is needed,
+convert it with ToBoolVoxelVolume().
+*/
+template<int X, int Y, int Z, typename Word = uint64_t>
+class FixedBoolVoxelVolume {
+public:
+  using Layout = FixedBoolVoxelLayout<Word, X, Y, Z>;
+  using VoxelWord = Word;
+  static constexpr int VoxelsPerWord = Layout::VoxelsPerWord;
+  static constexpr int BitIndexBits = Log<2>(VoxelsPerWord);
+  static constexpr VoxelWord BitIndexMask = VoxelsPerWord - 1;
+  using Voxels = std::array<VoxelWord, Layout::NumWords()>;
+
+  // all voxels start out 0
+  FixedBoolVoxelVolume() : voxels_{} {}
+
+  // the same voxels as "volume", which must be X x Y x Z
+  explicit FixedBoolVoxelVolume(const BasicBoolVoxelVolume<Word> &volume) {
+    assert(volume.XSize() == X);
+    assert(volume.YSize() == Y);
+    assert(volume.ZSize() == Z);
+    memcpy(voxels_.data(), volume.GetVoxels().data(), sizeof(voxels_));
+  }
+
+  static constexpr int XSize() { return X; }
+  static constexpr int YSize() { return Y; }
+  static constexpr int ZSize() { return Z; }
+  static constexpr int XWords() { return Layout::XWords(); }
+
+  bool Get(int x, int y, int z) const {
+    return (voxels_[WordIndex(x,y,z)] >> (x & BitIndexMask)) & 1;
+  }
+
+  void Set(int x, int y, int z) {
+    voxels_[WordIndex(x,y,z)] |= VoxelWord(1) << (x & BitIndexMask);
+  }
+
+  bool IsEmpty() const {
+    return !InlineWordOps::AnySet(voxels_.data(), voxels_.size());
+  }
+
+  BoolVoxelStats Stats() const { return StatsWords(Layout(), voxels_.data()); }
+
+  const Voxels& GetVoxels() const { return voxels_; }
+
+  // a BasicBoolVoxelVolume with the same voxels, e.g. for CreateBlockMesh
+  BasicBoolVoxelVolume<Word> ToBoolVoxelVolume() const {
+    BasicBoolVoxelVolume<Word> volume(X, Y, Z);
+    memcpy(volume.MutableVoxels(), voxels_.data(), sizeof(voxels_));
+    return volume;
+  }
+
+  // see BasicBoolVoxelVolume for what each of these do
+
+  FixedBoolVoxelVolume SweepX() const {
+    FixedBoolVoxelVolume swept;
+    SweepXWords<InlineWordOps>(Layout(), voxels_.data(), swept.voxels_.data());
+    return swept;
+  }
+
+  FixedBoolVoxelVolume SweepY() const {
+    FixedBoolVoxelVolume swept;
+    SweepYWords<InlineWordOps>(Layout(), voxels_.data(), swept.voxels_.data());
+    return swept;
+  }
+
+  FixedBoolVoxelVolume SweepZ() const {
+    FixedBoolVoxelVolume swept;
+    SweepZWords<InlineWordOps>(Layout(), voxels_.data(), swept.voxels_.data());
+    return swept;
+  }
+
+  FixedBoolVoxelVolume SweepPositive(Axis axis) const {
+    FixedBoolVoxelVolume swept;
+    SweepPositiveWords<InlineWordOps>(
+      Layout(), axis, voxels_.data(), swept.voxels_.data());
+    return swept;
+  }
+
+  FixedBoolVoxelVolume SweepNegative(Axis axis) const {
+    FixedBoolVoxelVolume swept;
+    SweepNegativeWords<InlineWordOps>(
+      Layout(), axis, voxels_.data(), swept.voxels_.data());
+    return swept;
+  }
+
+  FixedBoolVoxelVolume Dilate(
+    Neighborhood neighborhood, int iterations = 1
+  ) const {
+    FixedBoolVoxelVolume dilated;
+    MorphologyWords(Layout(), MorphologyOp::Dilate, neighborhood, iterations,
+      voxels_.data(), dilated.voxels_.data());
+    return dilated;
+  }
+
+  FixedBoolVoxelVolume Erode(
+    Neighborhood neighborhood, int iterations = 1
+  ) const {
+    FixedBoolVoxelVolume eroded;
+    MorphologyWords(Layout(), MorphologyOp::Erode, neighborhood, iterations,
+      voxels_.data(), eroded.voxels_.data());
+    return eroded;
+  }
+
+  FixedBoolVoxelVolume Open(
+    Neighborhood neighborhood, int iterations = 1
+  ) const {
+    return Erode(neighborhood, iterations).Dilate(neighborhood, iterations);
+  }
+
+  FixedBoolVoxelVolume Close(
+    Neighborhood neighborhood, int iterations = 1
+  ) const {
+    return Dilate(neighborhood, iterations).Erode(neighborhood, iterations);
+  }
+
+  FixedBoolVoxelVolume RotateX() const {
+    static_assert(Y == Z, "RotateX needs a square YZ cross-section");
+    FixedBoolVoxelVolume rotated;
+    RotateXWords(Layout(), voxels_.data(), rotated.voxels_.data());
+    return rotated;
+  }
+
+  FixedBoolVoxelVolume RotateY() const {
+    static_assert(X == Z, "RotateY needs a square XZ cross-section");
+    FixedBoolVoxelVolume rotated;
+    RotateYWords(Layout(), voxels_.data(), rotated.voxels_.data());
+    return rotated;
+  }
+
+  FixedBoolVoxelVolume RotateZ() const {
+    static_assert(X == Y, "RotateZ needs a square XY cross-section");
+    FixedBoolVoxelVolume rotated;
+    RotateZWords(Layout(), voxels_.data(), rotated.voxels_.data());
+    return rotated;
+  }
+
+  FixedBoolVoxelVolume Union(const FixedBoolVoxelVolume &b) const {
+    FixedBoolVoxelVolume c;
+    InlineWordOps::Or(
+      voxels_.data(), b.voxels_.data(), c.voxels_.data(), voxels_.size());
+    return c;
+  }
+
+  FixedBoolVoxelVolume Intersect(const FixedBoolVoxelVolume &b) const {
+    FixedBoolVoxelVolume c;
+    InlineWordOps::And(
+      voxels_.data(), b.voxels_.data(), c.voxels_.data(), voxels_.size());
+    return c;
+  }
+
+  FixedBoolVoxelVolume Subtract(const FixedBoolVoxelVolume &b) const {
+    FixedBoolVoxelVolume c;
+    InlineWordOps::AndNot(
+      voxels_.data(), b.voxels_.data(), c.voxels_.data(), voxels_.size());
+    return c;
+  }
+
+private:
+  static int WordIndex(int x, int y, int z) {
+    assert(x >= 0); assert(x < X);
+    assert(y >= 0); assert(y < Y);
+    assert(z >= 0); assert(z < Z);
+    return z * Layout::ZStride() + y * Layout::YStride() + (x >> BitIndexBits);
+  }
+
+  // voxels, in z-major order, packed as in BasicBoolVoxelVolume
+  Voxels voxels_;
+};
+
+#endif
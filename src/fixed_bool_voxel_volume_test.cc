@@ -0,0 +1,126 @@
+#include "fixed_bool_voxel_volume.h"
+
+#include "catch.h"
+
+#include <cstdint>
+#include <initializer_list>
+#include <random>
+#include <vector>
+
+namespace {
+
+// the same reproducible random pattern, in a fixed and a dynamic volume
+template<typename Fixed>
+void RandomVolumes(
+  int seed, Fixed *fixed, BasicBoolVoxelVolume<typename Fixed::VoxelWord> *v
+) {
+  std::mt19937 rng(seed);
+  for(int z = 0; z < Fixed::ZSize(); z++) {
+    for(int y = 0; y < Fixed::YSize(); y++) {
+      for(int x = 0; x < Fixed::XSize(); x++) {
+        if(rng() % 4 == 0) {
+          fixed->Set(x,y,z);
+          v->Set(x,y,z);
+        }
+      }
+    }
+  }
+}
+
+// whether "fixed" and "v" hold the same words, padding included
+template<typename Fixed>
+bool SameWords(
+  const Fixed &fixed, const BasicBoolVoxelVolume<typename Fixed::VoxelWord> &v
+) {
+  const auto &words = fixed.GetVoxels();
+  return std::vector<typename Fixed::VoxelWord>(words.begin(), words.end()) ==
+    v.GetVoxels();
+}
+
+// every op on a cubic FixedBoolVoxelVolume matches BasicBoolVoxelVolume's
+template<typename Fixed>
+void CheckMatchesDynamic() {
+  using Volume = BasicBoolVoxelVolume<typename Fixed::VoxelWord>;
+  const int size = Fixed::XSize();
+
+  Fixed a, b;
+  Volume dynamic_a(size, size, size), dynamic_b(size, size, size);
+  RandomVolumes(1, &a, &dynamic_a);
+  RandomVolumes(2, &b, &dynamic_b);
+  REQUIRE(SameWords(a, dynamic_a));
+
+  REQUIRE(!a.IsEmpty());
+  REQUIRE(Fixed().IsEmpty());
+  REQUIRE(SameWords(Fixed(dynamic_a), dynamic_a));
+
+  BoolVoxelStats stats = a.Stats();
+  BoolVoxelStats dynamic_stats = dynamic_a.Stats();
+  REQUIRE(stats.count == dynamic_stats.count);
+  REQUIRE(stats.exposed_faces == dynamic_stats.exposed_faces);
+  REQUIRE(stats.x_counts == dynamic_stats.x_counts);
+
+  REQUIRE(SameWords(a.SweepX(), dynamic_a.SweepX()));
+  REQUIRE(SameWords(a.SweepY(), dynamic_a.SweepY()));
+  REQUIRE(SameWords(a.SweepZ(), dynamic_a.SweepZ()));
+
+  // sparse enough that the one-directional sweeps don't fill everything
+  Fixed sparse;
+  Volume dynamic_sparse(size, size, size);
+  for(int i = 0; i < size; i += 7) {
+    sparse.Set(i, size - 1 - i, (i * 3) % size);
+    dynamic_sparse.Set(i, size - 1 - i, (i * 3) % size);
+  }
+  for(Axis axis: {Axis::X, Axis::Y, Axis::Z}) {
+    INFO("axis " << int(axis));
+    REQUIRE(SameWords(
+      sparse.SweepPositive(axis), dynamic_sparse.SweepPositive(axis)));
+    REQUIRE(SameWords(
+      sparse.SweepNegative(axis), dynamic_sparse.SweepNegative(axis)));
+  }
+
+  for(Neighborhood n: {Neighborhood::Six, Neighborhood::TwentySix}) {
+    INFO("neighborhood " << int(n));
+    REQUIRE(SameWords(a.Dilate(n), dynamic_a.Dilate(n)));
+    REQUIRE(SameWords(a.Erode(n), dynamic_a.Erode(n)));
+    REQUIRE(SameWords(a.Open(n, 2), dynamic_a.Open(n, 2)));
+    REQUIRE(SameWords(a.Close(n, 2), dynamic_a.Close(n, 2)));
+  }
+
+  REQUIRE(SameWords(a.RotateX(), dynamic_a.RotateX()));
+  REQUIRE(SameWords(a.RotateY(), dynamic_a.RotateY()));
+  REQUIRE(SameWords(a.RotateZ(), dynamic_a.RotateZ()));
+
+  REQUIRE(SameWords(a.Union(b), dynamic_a.Union(dynamic_b)));
+  REQUIRE(SameWords(a.Intersect(b), dynamic_a.Intersect(dynamic_b)));
+  REQUIRE(SameWords(a.Subtract(b), dynamic_a.Subtract(dynamic_b)));
+}
+
+} // namespace
+
+TEST_CASE("FixedBoolVoxelVolume matches BoolVoxelVolume") {
+  SECTION("words fit rows exactly") {
+    CheckMatchesDynamic<FixedBoolVoxelVolume<32, 32, 32, uint32_t>>();
+  }
+  SECTION("padded rows") {
+    CheckMatchesDynamic<FixedBoolVoxelVolume<20, 20, 20, uint16_t>>();
+    CheckMatchesDynamic<FixedBoolVoxelVolume<37, 37, 37>>();
+  }
+}
+
+TEST_CASE("FixedBoolVoxelVolume converts to BoolVoxelVolume") {
+  FixedBoolVoxelVolume<10, 6, 4> fixed;
+  fixed.Set(0, 0, 0);
+  fixed.Set(9, 5, 3);
+  fixed.Set(4, 2, 1);
+
+  BoolVoxelVolume v = fixed.ToBoolVoxelVolume();
+  REQUIRE(v.XSize() == 10);
+  REQUIRE(v.YSize() == 6);
+  REQUIRE(v.ZSize() == 4);
+  for(int z = 0; z < 4; z++) {
+    for(int y = 0; y < 6; y++) {
+      for(int x = 0; x < 10; x++)
+        REQUIRE(v.Get(x,y,z) == fixed.Get(x,y,z));
+    }
+  }
+}
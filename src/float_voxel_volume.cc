@@ -0,0 +1,14 @@
+#include "float_voxel_volume.h"
+
+FloatVoxelVolume::FloatVoxelVolume(int x_size, int y_size, int z_size) :
+  VoxelVolume(x_size, y_size, z_size),
+  voxels_(size_t(x_size) * y_size * z_size)
+{}
+
+bool FloatVoxelVolume::GetBool(int x, int y, int z) const /*override*/ {
+  return Get(x,y,z) <= 0;
+}
+
+Color FloatVoxelVolume::GetColor(int x, int y, int z) const /*override*/ {
+  return Color::White;
+}
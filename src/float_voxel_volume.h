@@ -0,0 +1,41 @@
+#ifndef FLOAT_VOXEL_VOLUME_H
+#define FLOAT_VOXEL_VOLUME_H
+
+#include "voxel_volume.h"
+
+#include <vector>
+
+/*
+A VoxelVolume where each voxel is a float, e.g. a signed distance field.
+
+GetBool is true where the value is <= 0, i.e. inside, by the signed distance
+convention.
+*/
+class FloatVoxelVolume : public VoxelVolume {
+public:
+  using Voxel = float;
+
+  // all voxels start out 0
+  FloatVoxelVolume(int x_size, int y_size, int z_size);
+  virtual ~FloatVoxelVolume() {}
+
+  Voxel Get(int x, int y, int z) const {
+    return voxels_[VoxelIndex(x,y,z)];
+  }
+
+  void Set(int x, int y, int z, Voxel v) {
+    voxels_[VoxelIndex(x,y,z)] = v;
+  }
+
+  bool GetBool(int x, int y, int z) const override;
+  Color GetColor(int x, int y, int z) const override;
+
+  // the voxels, in z-major order, i.e. voxel x,y,z is at VoxelIndex(x,y,z)
+  const std::vector<Voxel>& GetVoxels() const { return voxels_; }
+  Voxel* MutableVoxels() { return voxels_.data(); }
+
+private:
+  std::vector<Voxel> voxels_;
+};
+
+#endif
@@ -1,28 +1,380 @@
 #include "labeled_voxel_volume.h"
 
 #include "math/util.h"
+#include "ohno.h"
+#include "parallel_for.h"
 
+#include <algorithm>
+#include <cassert>
 #include <cstring>
 #include <limits>
-#include <map>
-#include <set>
 #include <string>
-#include <unordered_map>
 #include <utility>
 
-LabeledVoxelVolume::LabeledVoxelVolume(int x_size, int y_size, int z_size) :
+namespace {
+
+using Voxel = LabeledVoxelVolume::Voxel;
+using Labels = LabeledVoxelVolume::Labels;
+using VoxelPairWord = uint64_t; // a word big enough to hold 2 Voxels
+constexpr int VoxelBits = std::numeric_limits<Voxel>::digits;
+constexpr uint32_t NoLabel = std::numeric_limits<uint32_t>::max();
+
+// the type of the elements of a std::vector of labels
+template<typename LabelVector>
+using LabelOf = typename std::decay_t<LabelVector>::value_type;
+
+// storage for "size" labels of the narrowest type that holds "max_label"
+Labels MakeLabels(Voxel max_label, size_t size) {
+  if(max_label <= std::numeric_limits<uint8_t>::max())
+    return std::vector<uint8_t>(size);
+  if(max_label <= std::numeric_limits<uint16_t>::max())
+    return std::vector<uint16_t>(size);
+  return std::vector<uint32_t>(size);
+}
+
+// a voxel and its overlaid voxel, as one word
+VoxelPairWord MakePair(Voxel a, Voxel b) {
+  return (VoxelPairWord(a) << VoxelBits) | b;
+}
+
+// the start of chunk "i" of [0, size) split into "chunks" nearly equal parts,
+// like SplitRange, for sizes that may not fit in an int
+size_t ChunkBegin(size_t size, int chunks, int i) {
+  return size * i / chunks;
+}
+
+// A map from voxel pairs to labels, as a table with an entry for every pair
+// of labels up to the largest in each volume. Only for small label counts,
+// when the table fits in cache.
+class DirectPairTable {
+public:
+  static constexpr size_t MaxEntries = size_t(1) << 16;
+
+  static bool Fits(Voxel max_a, Voxel max_b) {
+    return (uint64_t(max_a) + 1) * (uint64_t(max_b) + 1) <= MaxEntries;
+  }
+
+  DirectPairTable(Voxel max_a, Voxel max_b) :
+    b_labels_(size_t(max_b) + 1),
+    labels_((size_t(max_a) + 1) * b_labels_, NoLabel)
+  {}
+
+  // the label of "pair", or NoLabel
+  uint32_t Get(VoxelPairWord pair) const { return labels_[Index(pair)]; }
+
+  // give "pair" a label, unless it has one already; true if it didn't
+  bool Insert(VoxelPairWord pair, uint32_t label) {
+    uint32_t &entry = labels_[Index(pair)];
+    if(entry != NoLabel)
+      return false;
+    entry = label;
+    return true;
+  }
+
+private:
+  size_t Index(VoxelPairWord pair) const {
+    const size_t a = size_t(pair >> VoxelBits);
+    const size_t b = size_t(pair & std::numeric_limits<Voxel>::max());
+    return a * b_labels_ + b;
+  }
+
+  size_t b_labels_;
+  std::vector<uint32_t> labels_;
+};
+
+// An open-addressed hash map from unsigned integer keys to uint32_t values,
+// other than NoLabel, with linear probing in one flat array. FlatPairMap does
+// the same as DirectPairTable for any number of labels.
+template<typename Key>
+class FlatMap {
+public:
+  FlatMap() : slots_(MinCapacity, Slot {0, NoLabel}) {}
+
+  // the value of "key", or NoLabel
+  uint32_t Get(Key key) const {
+    for(size_t i = Home(key); ; i = (i + 1) & Mask()) {
+      const Slot &slot = slots_[i];
+      if(slot.value == NoLabel || slot.key == key)
+        return slot.value;
+    }
+  }
+
+  // give "key" a value, unless it has one already; true if it didn't
+  bool Insert(Key key, uint32_t value) {
+    for(size_t i = Home(key); ; i = (i + 1) & Mask()) {
+      Slot &slot = slots_[i];
+      if(slot.value == NoLabel) {
+        // keep the load at most 1/2, so probes stay short
+        if((size_ + 1) * 2 > slots_.size()) {
+          Grow();
+          return Insert(key, value);
+        }
+        slot = Slot {key, value};
+        size_++;
+        return true;
+      }
+      if(slot.key == key)
+        return false;
+    }
+  }
+
+private:
+  static constexpr int MinCapacityBits = 10;
+  static constexpr size_t MinCapacity = size_t(1) << MinCapacityBits;
+
+  struct Slot {
+    Key key;
+    uint32_t value; // NoLabel if the slot is empty
+  };
+
+  size_t Mask() const { return slots_.size() - 1; }
+
+  // Fibonacci hashing: the top bits of the product mix all the key's bits
+  size_t Home(Key key) const {
+    return size_t((uint64_t(key) * 0x9e3779b97f4a7c15ull) >> home_shift_);
+  }
+
+  void Grow() {
+    std::vector<Slot> old_slots(slots_.size() * 2, Slot {0, NoLabel});
+    old_slots.swap(slots_);
+    home_shift_--;
+    size_ = 0;
+    for(const Slot &slot: old_slots) {
+      if(slot.value != NoLabel)
+        Insert(slot.key, slot.value);
+    }
+  }
+
+  std::vector<Slot> slots_;
+  size_t size_ = 0;
+  int home_shift_ = 64 - MinCapacityBits; // 64 - log2(slots_.size())
+};
+
+using FlatPairMap = FlatMap<VoxelPairWord>;
+
+/*
+The pairs of labels in "voxels" and "overlay", both "size" voxels long, split
+into a chunk per thread. Each chunk lists the pairs in its voxels in order of
+first appearance.
+*/
+template<typename LabelA, typename LabelB>
+std::vector<std::vector<VoxelPairWord>> ListPairs(
+  const LabelA *voxels, const LabelB *overlay, size_t size
+) {
+  const int chunks = ParallelThreads();
+  std::vector<std::vector<VoxelPairWord>> chunk_pairs(chunks);
+  ParallelFor(0, chunks, [&](int chunk) {
+    const size_t begin = ChunkBegin(size, chunks, chunk);
+    const size_t end = ChunkBegin(size, chunks, chunk + 1);
+    if(begin == end)
+      return;
+    FlatPairMap seen;
+    std::vector<VoxelPairWord> &pairs = chunk_pairs[chunk];
+    // anything but the first pair, to start off the first run
+    VoxelPairWord last = ~MakePair(voxels[begin], overlay[begin]);
+    for(size_t i = begin; i < end; i++) {
+      const VoxelPairWord pair = MakePair(voxels[i], overlay[i]);
+      // neighboring voxels usually have the same pair
+      if(pair == last)
+        continue;
+      last = pair;
+      if(seen.Insert(pair, 0))
+        pairs.push_back(pair);
+    }
+  });
+  return chunk_pairs;
+}
+
+/*
+Relabel "voxels" with a label for each pair listed by ListPairs, into
+"merged", and return the number of labels. The labels are numbered in order
+of first appearance, with (0, 0) as 0, exactly as if the voxels were scanned
+one by one in a single pass.
+
+The chunks' lists are numbered one after the other, serially, into "labels",
+which is then only read as the chunks relabel their voxels in parallel.
+
+"merged" becomes storage of the width the number of labels needs. It may be
+"voxels" itself, which is relabeled in place if it's that width already.
+*/
+template<typename PairTable>
+uint32_t RelabelPairs(
+  const Labels &voxels, const Labels &overlay, size_t size,
+  const std::vector<std::vector<VoxelPairWord>> &chunk_pairs,
+  PairTable labels, Labels *merged
+) {
+  labels.Insert(MakePair(0, 0), 0);
+  uint32_t next_label = 1;
+  for(const std::vector<VoxelPairWord> &pairs: chunk_pairs) {
+    for(VoxelPairWord pair: pairs) {
+      // checked before relabeling anything, so the volume is left as it was
+      if(labels.Insert(pair, next_label) && ++next_label == NoLabel)
+        throw OHNO("too many labels for LabeledVoxelVolume::Merge");
+    }
+  }
+
+  const Voxel max_label = next_label - 1;
+  Labels new_storage;
+  Labels *out_storage = merged;
+  if(MakeLabels(max_label, 0).index() != merged->index()) {
+    new_storage = MakeLabels(max_label, size);
+    out_storage = &new_storage;
+  }
+
+  const int chunks = int(chunk_pairs.size());
+  std::visit([&](const auto &a, const auto &b, auto &out) {
+    using OutLabel = LabelOf<decltype(out)>;
+    ParallelFor(0, chunks, [&](int chunk) {
+      const size_t begin = ChunkBegin(size, chunks, chunk);
+      const size_t end = ChunkBegin(size, chunks, chunk + 1);
+      if(begin == end)
+        return;
+      VoxelPairWord last = ~MakePair(a[begin], b[begin]);
+      OutLabel last_label = 0;
+      for(size_t i = begin; i < end; i++) {
+        const VoxelPairWord pair = MakePair(a[i], b[i]);
+        if(pair != last) {
+          last = pair;
+          last_label = OutLabel(labels.Get(pair));
+        }
+        out[i] = last_label;
+      }
+    });
+  }, voxels, overlay, *out_storage);
+
+  if(out_storage != merged)
+    *merged = std::move(new_storage);
+  return next_label;
+}
+
+// Transpose a matrix of "rows" x "cols" labels at "source", whose rows are
+// "source_stride" labels apart: label (r, c) goes to
+// dest[c * dest_stride + r * dest_step]. It's done in square tiles, each row
+// of which is a cache line, so both the reads and the writes stay within a
+// few cache lines at a time.
+template<typename Label>
+void TransposeTiles(
+  const Label *source, ptrdiff_t source_stride, int rows, int cols,
+  Label *dest, ptrdiff_t dest_stride, ptrdiff_t dest_step
+) {
+  constexpr int TileSize = 64 / sizeof(Label);
+  for(int tile_r = 0; tile_r < rows; tile_r += TileSize) {
+    const int r_end = std::min(rows, tile_r + TileSize);
+    for(int tile_c = 0; tile_c < cols; tile_c += TileSize) {
+      const int c_end = std::min(cols, tile_c + TileSize);
+      for(int c = tile_c; c < c_end; c++) {
+        Label *dest_row = dest + c * dest_stride;
+        for(int r = tile_r; r < r_end; r++)
+          dest_row[r * dest_step] = source[r * source_stride + c];
+      }
+    }
+  }
+}
+
+// a 64-bit hash of "n" labels
+uint64_t HashLabels(const Voxel *labels, int n) {
+  // FNV-1a, a label at a time
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for(int i = 0; i < n; i++) {
+    hash ^= labels[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// the distinct labels in a row of "x_size" voxels, sorted
+template<typename Label>
+void RowLabels(const Label *row, int x_size, std::vector<Voxel> *labels) {
+  labels->clear();
+  // rows are mostly runs, so only collect the label at the start of each
+  labels->push_back(row[0]);
+  for(int x = 1; x < x_size; x++) {
+    if(row[x] != row[x - 1])
+      labels->push_back(row[x]);
+  }
+  std::sort(labels->begin(), labels->end());
+  labels->erase(std::unique(labels->begin(), labels->end()), labels->end());
+}
+
+// A list of row classes, i.e. distinct sets of labels in rows, numbered in the
+// order they're added. Each class's sorted labels are stored one after
+// another in one array, and found by a hash of them.
+class RowClasses {
+public:
+  RowClasses() : starts_(1, 0) {}
+
+  int Size() const { return int(hashes_.size()); }
+  const Voxel* Labels(int c) const { return labels_.data() + starts_[c]; }
+  int NumLabels(int c) const { return int(starts_[c + 1] - starts_[c]); }
+  uint64_t Hash(int c) const { return hashes_[c]; }
+
+  // the largest label in any class
+  Voxel MaxLabel() const { return max_label_; }
+
+  // the class with "n" sorted "labels", whose hash is "hash", adding it if
+  // there isn't one; "added" says whether it was added
+  int Find(const Voxel *labels, int n, uint64_t hash, bool *added) {
+    *added = false;
+    int last = -1;
+    for(int c = ClassOrNone(by_hash_.Get(hash)); c >= 0; c = next_[c]) {
+      if(NumLabels(c) == n &&
+         std::equal(labels, labels + n, labels_.begin() + starts_[c]))
+        return c;
+      last = c;
+    }
+
+    const int c = Size();
+    labels_.insert(labels_.end(), labels, labels + n);
+    starts_.push_back(labels_.size());
+    hashes_.push_back(hash);
+    next_.push_back(-1);
+    max_label_ = std::max(max_label_, labels[n - 1]);
+    // a hash collision, which should practically never happen
+    if(last >= 0)
+      next_[last] = c;
+    else
+      by_hash_.Insert(hash, uint32_t(c));
+    *added = true;
+    return c;
+  }
+
+private:
+  static int ClassOrNone(uint32_t value) {
+    return value == NoLabel ? -1 : int(value);
+  }
+
+  std::vector<Voxel> labels_;
+  std::vector<size_t> starts_; // class c's labels start at labels_[starts_[c]]
+  std::vector<uint64_t> hashes_;
+  std::vector<int> next_; // the next class with the same hash, or -1
+  FlatMap<uint64_t> by_hash_; // the first class with each hash
+  Voxel max_label_ = 0;
+};
+
+} // namespace
+
+LabeledVoxelVolume::LabeledVoxelVolume(
+  int x_size, int y_size, int z_size, Voxel max_label
+) :
   VoxelVolume(x_size, y_size, z_size),
-  voxels_(x_size * y_size * z_size)
-{
-  assert(x_size % VoxelsPerMaxWord == 0);
+  labels_(MakeLabels(max_label, size_t(x_size) * y_size * z_size))
+{}
+
+void LabeledVoxelVolume::WidenLabels(Voxel max_label) {
+  Labels wider = MakeLabels(max_label, 0);
+  assert(wider.index() > labels_.index());
+  std::visit([&](const auto &labels, auto &wider_labels) {
+    wider_labels.assign(labels.begin(), labels.end());
+  }, labels_, wider);
+  labels_ = std::move(wider);
 }
 
 bool LabeledVoxelVolume::GetBool(int x, int y, int z) const /*override*/ {
-  return voxels_[VoxelIndex(x,y,z)];
+  return Get(x,y,z);
 }
 
 Color LabeledVoxelVolume::GetColor(int x, int y, int z) const /*override*/ {
-  Voxel voxel = voxels_[VoxelIndex(x,y,z)];
+  Voxel voxel = Get(x,y,z);
 
   // hash the value to pick a hue
   for(int i = 0; i < 3; i++) {
@@ -41,157 +393,349 @@ Color LabeledVoxelVolume::GetColor(int x, int y, int z) const /*override*/ {
 }
 
 bool LabeledVoxelVolume::IsEmpty() const {
-  size_t size = VoxelMaxWordNum();
-  const VoxelMaxWord *data = VoxelsAsMaxWords();
-  for(size_t i = 0; i < size; i++) {
-    if(data[i])
-      return false;
-  }
-  return true;
+  return VisitLabels([](const auto &labels) {
+    return std::all_of(labels.begin(), labels.end(),
+      [](auto label) { return label == 0; });
+  });
 }
 
+template<typename Func>
+LabeledVoxelVolume LabeledVoxelVolume::Transformed(Func f) const {
+  LabeledVoxelVolume transformed(x_size_, y_size_, z_size_, MaxStorableLabel());
+  VisitLabels([&](const auto &labels) {
+    auto &dest = std::get<std::decay_t<decltype(labels)>>(transformed.labels_);
+    f(labels.data(), dest.data());
+  });
+  return transformed;
+}
+
+/*
+The rotations are transposes, of YZ planes for RotateX, XZ planes for RotateY,
+and XY planes for RotateZ. RotateX moves whole rows, but the others read or
+write with a stride of a row or slab per voxel. So they work in square tiles,
+where each row of a tile is one cache line, and every line read or written is
+used in full while it's still in cache.
+
+Each thread writes its own range of destination Z slabs.
+*/
+
 LabeledVoxelVolume LabeledVoxelVolume::RotateX() const {
   assert(y_size_ == z_size_);
 
-  const int y_stride = x_size_;
-  const int z_stride = x_size_ * y_size_;
-
-  LabeledVoxelVolume rotated(x_size_, y_size_, z_size_);
-  Voxel *dest_data = rotated.voxels_.data();
-  const Voxel *source_row = voxels_.data();
-  for(int z = 0; z < z_size_; z++) {
-    Voxel *dest_row = dest_data + VoxelIndex(0, y_size_ - 1 - z, 0);
-    for(int y = 0; y < y_size_; y++) {
-      memcpy(dest_row, source_row, x_size_ * sizeof(Voxel));
-      source_row += y_stride;
-      dest_row += z_stride;
-    }
-  }
-  return rotated;
+  // voxel (x, y, z) goes to (x, y_size_ - 1 - z, y), so source row (y, z) is
+  // destination row (y_size_ - 1 - z, y)
+  return Transformed([&](const auto *source, auto *dest) {
+    ParallelFor(0, z_size_, [&](int dest_z) {
+      for(int dest_y = 0; dest_y < y_size_; dest_y++) {
+        memcpy(dest + VoxelIndex(0, dest_y, dest_z),
+          source + VoxelIndex(0, dest_z, y_size_ - 1 - dest_y),
+          x_size_ * sizeof(*source));
+      }
+    });
+  });
 }
 
 LabeledVoxelVolume LabeledVoxelVolume::RotateY() const {
   assert(x_size_ == z_size_);
 
-  const int z_stride = x_size_ * y_size_;
-
-  LabeledVoxelVolume rotated(x_size_, y_size_, z_size_);
-  Voxel *dest_data = rotated.voxels_.data();
-  const Voxel *source_voxel = voxels_.data();
-  for(int z = 0; z < z_size_; z++) {
-    for(int y = 0; y < y_size_; y++) {
-      Voxel *dest_voxel = dest_data + VoxelIndex(z, y, z_size_ - 1);
-      for(int x = 0; x < x_size_; x++) {
-        *dest_voxel = *source_voxel;
-        source_voxel++;
-        dest_voxel -= z_stride;
+  // voxel (x, y, z) goes to (z, y, z_size_ - 1 - x); each chunk of a tile's
+  // worth of destination slabs comes from a tile's worth of source columns
+  const ptrdiff_t z_stride = ptrdiff_t(x_size_) * y_size_;
+  return Transformed([&](const auto *source, auto *dest) {
+    constexpr int TileSize = 64 / sizeof(*source);
+    const int tiles = (z_size_ + TileSize - 1) / TileSize;
+    ParallelFor(0, tiles, [&](int tile) {
+      const int dest_z = tile * TileSize;
+      const int dest_z_end = std::min(z_size_, dest_z + TileSize);
+      // the source columns, from x_end - 1 down to x
+      const int x = x_size_ - dest_z_end, x_end = x_size_ - dest_z;
+      for(int y = 0; y < y_size_; y++) {
+        TransposeTiles(source + VoxelIndex(x, y, 0), z_stride,
+          z_size_, x_end - x,
+          dest + VoxelIndex(0, y, dest_z_end - 1), -z_stride, 1);
       }
-    }
-  }
-  return rotated;
+    });
+  });
 }
 
 LabeledVoxelVolume LabeledVoxelVolume::RotateZ() const {
   assert(x_size_ == y_size_);
 
-  const int y_stride = x_size_;
-
-  LabeledVoxelVolume rotated(x_size_, y_size_, z_size_);
-  Voxel *dest_data = rotated.voxels_.data();
-  const Voxel *source_voxel = voxels_.data();
-  for(int z = 0; z < z_size_; z++) {
-    for(int y = 0; y < y_size_; y++) {
-      Voxel *dest_voxel = dest_data + VoxelIndex(x_size_ - 1 - y, 0, z);
-      for(int x = 0; x < x_size_; x++) {
-        *dest_voxel = *source_voxel;
-        source_voxel++;
-        dest_voxel += y_stride;
-      }
-    }
-  }
-  return rotated;
+  // voxel (x, y, z) goes to (x_size_ - 1 - y, x, z), within each slab
+  return Transformed([&](const auto *source, auto *dest) {
+    ParallelFor(0, z_size_, [&](int z) {
+      TransposeTiles(source + VoxelIndex(0, 0, z), x_size_, y_size_, x_size_,
+        dest + VoxelIndex(x_size_ - 1, 0, z), x_size_, -1);
+    });
+  });
 }
 
-void LabeledVoxelVolume::Merge(const LabeledVoxelVolume &overlay) {
-  using VoxelPair = union {
-    struct { Voxel a, b; };
-    VoxelPairWord ab;
-  };
+LabeledVoxelVolume LabeledVoxelVolume::MirrorX() const {
+  return Transformed([&](const auto *source, auto *dest) {
+    ParallelFor(0, z_size_, [&](int z) {
+      for(int y = 0; y < y_size_; y++) {
+        const auto *row = source + VoxelIndex(0, y, z);
+        std::reverse_copy(row, row + x_size_, dest + VoxelIndex(0, y, z));
+      }
+    });
+  });
+}
 
-  std::unordered_map<VoxelPairWord, Voxel> new_labels;
-  new_labels.insert(std::pair<VoxelPairWord, Voxel>(0,0));
-  Voxel next_label = 1;
-
-  Voxel *a_voxel = voxels_.data();
-  const Voxel *b_voxel = overlay.voxels_.data();
-  for(int z = 0; z < z_size_; z++) {
-    for(int y = 0; y < y_size_; y++) {
-      for(int x = 0; x < x_size_; x++) {
-        VoxelPair pair;
-        pair.a = *a_voxel;
-        pair.b = *b_voxel;
-        auto new_label = new_labels.find(pair.ab);
-        if(new_label == new_labels.end()) {
-          new_label = new_labels.insert(std::pair(pair.ab, next_label)).first;
-          next_label++;
-        }
-        *a_voxel = new_label->second;
-        a_voxel++;
-        b_voxel++;
+LabeledVoxelVolume LabeledVoxelVolume::MirrorY() const {
+  return Transformed([&](const auto *source, auto *dest) {
+    ParallelFor(0, z_size_, [&](int z) {
+      for(int y = 0; y < y_size_; y++) {
+        memcpy(dest + VoxelIndex(0, y_size_ - 1 - y, z),
+          source + VoxelIndex(0, y, z), x_size_ * sizeof(*source));
       }
+    });
+  });
+}
+
+LabeledVoxelVolume LabeledVoxelVolume::MirrorZ() const {
+  const size_t slab_size = size_t(x_size_) * y_size_;
+  return Transformed([&](const auto *source, auto *dest) {
+    ParallelFor(0, z_size_, [&](int z) {
+      memcpy(dest + VoxelIndex(0, 0, z_size_ - 1 - z),
+        source + VoxelIndex(0, 0, z), slab_size * sizeof(*source));
+    });
+  });
+}
+
+void LabeledVoxelVolume::Merge(const LabeledVoxelVolume &overlay) {
+  assert(x_size_ == overlay.x_size_);
+  assert(y_size_ == overlay.y_size_);
+  assert(z_size_ == overlay.z_size_);
+
+  const size_t size = size_t(x_size_) * y_size_ * z_size_;
+  const auto chunk_pairs = std::visit(
+    [&](const auto &labels, const auto &overlay_labels) {
+      return ListPairs(labels.data(), overlay_labels.data(), size);
+    },
+    labels_, overlay.labels_);
+
+  // a direct table if there are few enough possible pairs, else a hash map
+  Voxel max_label = 0, max_overlay_label = 0;
+  for(const std::vector<VoxelPairWord> &pairs: chunk_pairs) {
+    for(VoxelPairWord pair: pairs) {
+      max_label = std::max(max_label, Voxel(pair >> VoxelBits));
+      max_overlay_label = std::max(max_overlay_label, Voxel(pair));
     }
   }
+  uint32_t labels;
+  if(DirectPairTable::Fits(max_label, max_overlay_label)) {
+    labels = RelabelPairs(labels_, overlay.labels_, size, chunk_pairs,
+      DirectPairTable(max_label, max_overlay_label), &labels_);
+  } else {
+    labels = RelabelPairs(labels_, overlay.labels_, size, chunk_pairs,
+      FlatPairMap(), &labels_);
+  }
 
-  std::cout << "LabeledVoxelVolume::Merge labels=" << next_label << '\n';
+  std::cout << "LabeledVoxelVolume::Merge labels=" << labels << '\n';
 }
 
+/*
+Every distinct set of labels in a row, i.e. row class, gets a new label for
+each label in it, in order of the class's first appearance and then of label.
+
+This runs in three steps, like Merge. First each thread finds the classes of
+its chunk of rows. Then the chunks' classes are numbered serially, so the
+labels don't depend on the number of threads. Finally, the chunks are
+relabeled in parallel, a row at a time through a flat table of its class's new
+labels, into storage of the width the number of labels needs.
+*/
 void LabeledVoxelVolume::SweepXAndMerge() {
-  // map<set<int>, int> works but unordered_map<set<int>, int> doesn't
-  std::map<std::set<Voxel>, std::map<Voxel,Voxel>> new_labels;
-
-  // no need to relabel an empty row
-  static const auto empty_row_set = std::set<Voxel>({0});
-  new_labels.insert(std::make_pair(empty_row_set, std::map<Voxel,Voxel>()));
-
-  Voxel next_label = 1;
-
-  for(int z = 0; z < z_size_; z++) {
-    for(int y = 0; y < y_size_; y++) {
-      const auto row_start_iter = voxels_.begin() + VoxelIndex(0,y,z);
-      const auto row_end_iter = row_start_iter + x_size_;
-      std::set<Voxel> row_set(row_start_iter, row_end_iter);
-
-      if(row_set == empty_row_set) continue;
-
-      // get the mapping which says how to relabel this class of row
-      auto row_remapping_iter = new_labels.find(row_set);
-      if(row_remapping_iter == new_labels.end()) {
-        // generate new labels for this class of row
-        std::map<Voxel,Voxel> row_remapping;
-        for(Voxel label: row_set) {
-          row_remapping.insert(std::make_pair(label, next_label));
-          next_label++;
+  const int rows = y_size_ * z_size_;
+  const int chunks = std::min(rows, ParallelThreads());
+
+  // 1. the class of each row within its chunk, or -1 for rows of only 0,
+  // which don't need relabeling
+  std::vector<RowClasses> chunk_classes(chunks);
+  std::vector<int> row_classes(rows);
+  VisitLabels([&](const auto &voxels) {
+    ParallelFor(0, chunks, [&](int chunk) {
+      RowClasses &classes = chunk_classes[chunk];
+      std::vector<Voxel> labels;
+      const int row_end = SplitRange(0, rows, chunks, chunk + 1);
+      for(int row = SplitRange(0, rows, chunks, chunk); row < row_end; row++) {
+        RowLabels(voxels.data() + size_t(row) * x_size_, x_size_, &labels);
+        if(labels.size() == 1 && labels[0] == 0) {
+          row_classes[row] = -1;
+          continue;
         }
-
-        row_remapping_iter = new_labels.insert(
-          std::make_pair(row_set, std::move(row_remapping))
-        ).first;
+        bool added;
+        row_classes[row] = classes.Find(labels.data(), int(labels.size()),
+          HashLabels(labels.data(), int(labels.size())), &added);
       }
-      std::map<Voxel,Voxel> &row_remapping = row_remapping_iter->second;
-
-      // relabel this row
-      auto row_iter = row_start_iter;
-      for(int x = 0; x < x_size_; x++) {
-        *row_iter = row_remapping.at(*row_iter);
-        row_iter++;
+    });
+  });
+
+  // 2. number the classes across all the chunks, and give each one its labels
+  RowClasses classes;
+  std::vector<uint32_t> first_labels; // the new label of each class's 1st label
+  std::vector<std::vector<int>> to_classes(chunks); // chunk class -> class
+  uint64_t next_label = 1;
+  for(int chunk = 0; chunk < chunks; chunk++) {
+    const RowClasses &local = chunk_classes[chunk];
+    for(int c = 0; c < local.Size(); c++) {
+      bool added;
+      to_classes[chunk].push_back(classes.Find(
+        local.Labels(c), local.NumLabels(c), local.Hash(c), &added));
+      if(added) {
+        first_labels.push_back(uint32_t(next_label));
+        next_label += local.NumLabels(c);
+        // check before relabeling anything, so the volume is left as it was
+        if(next_label - 1 > std::numeric_limits<Voxel>::max())
+          throw OHNO("too many labels for LabeledVoxelVolume::SweepXAndMerge");
       }
     }
   }
 
+  // 3. relabel, in place if the width stays the same
+  Labels swept;
+  Labels *out_storage = &labels_;
+  if(MakeLabels(Voxel(next_label - 1), 0).index() != labels_.index()) {
+    swept = MakeLabels(Voxel(next_label - 1), size_t(rows) * x_size_);
+    out_storage = &swept;
+  }
+  // a flat table from old label to new, per thread, if it's not too big;
+  // otherwise binary search each run's label in its class
+  constexpr Voxel MaxTableLabel = (1 << 20) - 1;
+  const bool use_table = classes.MaxLabel() <= MaxTableLabel;
+  std::visit([&](const auto &voxels, auto &out) {
+    using OutLabel = LabelOf<decltype(out)>;
+    ParallelFor(0, chunks, [&](int chunk) {
+      std::vector<OutLabel> new_labels(
+        use_table ? size_t(classes.MaxLabel()) + 1 : 0);
+      const int row_end = SplitRange(0, rows, chunks, chunk + 1);
+      for(int row = SplitRange(0, rows, chunks, chunk); row < row_end; row++) {
+        const size_t row_start = size_t(row) * x_size_;
+        if(row_classes[row] < 0) {
+          // all 0, which is still 0
+          std::fill_n(out.data() + row_start, x_size_, OutLabel(0));
+          continue;
+        }
+        const int c = to_classes[chunk][row_classes[row]];
+        const Voxel *labels = classes.Labels(c);
+        const int num_labels = classes.NumLabels(c);
+        if(use_table) {
+          for(int i = 0; i < num_labels; i++)
+            new_labels[labels[i]] = OutLabel(first_labels[c] + i);
+          for(int x = 0; x < x_size_; x++)
+            out[row_start + x] = new_labels[voxels[row_start + x]];
+        } else {
+          for(int x = 0; x < x_size_; x++) {
+            const Voxel label = voxels[row_start + x];
+            const int i = int(
+              std::lower_bound(labels, labels + num_labels, label) - labels);
+            out[row_start + x] = OutLabel(first_labels[c] + i);
+          }
+        }
+      }
+    });
+  }, labels_, *out_storage);
+  if(out_storage != &labels_)
+    labels_ = std::move(swept);
+
   std::cout << "LabeledVoxelVolume::SweepXAndMerge labels=" << next_label
     << '\n';
 }
 
+std::vector<size_t> LabeledVoxelVolume::Histogram() const {
+  const size_t size = size_t(x_size_) * y_size_ * z_size_;
+  const int chunks = ParallelThreads();
+
+  // the largest label, which the counts are sized to
+  std::vector<Voxel> chunk_max(chunks, 0);
+  VisitLabels([&](const auto &labels) {
+    ParallelFor(0, chunks, [&](int chunk) {
+      const auto begin = labels.begin() + ChunkBegin(size, chunks, chunk);
+      const auto end = labels.begin() + ChunkBegin(size, chunks, chunk + 1);
+      if(begin != end)
+        chunk_max[chunk] = *std::max_element(begin, end);
+    });
+  });
+  const Voxel max_label =
+    *std::max_element(chunk_max.begin(), chunk_max.end());
+  std::vector<size_t> counts(size_t(max_label) + 1);
+
+  // A table per thread, summed afterward, if they fit in cache. Otherwise
+  // every thread adds to "counts" itself, atomically, so memory is only the
+  // result's whatever the number of threads. Runs are counted a run at a
+  // time, so long runs of the same label cost one add.
+  constexpr Voxel MaxTableLabel = (1 << 16) - 1;
+  const bool use_tables = max_label <= MaxTableLabel;
+  std::vector<std::vector<size_t>> chunk_counts(use_tables ? chunks : 0);
+  VisitLabels([&](const auto &labels) {
+    ParallelFor(0, chunks, [&](int chunk) {
+      size_t *table = counts.data();
+      if(use_tables) {
+        chunk_counts[chunk].resize(counts.size());
+        table = chunk_counts[chunk].data();
+      }
+      const size_t end = ChunkBegin(size, chunks, chunk + 1);
+      size_t i = ChunkBegin(size, chunks, chunk);
+      while(i < end) {
+        const Voxel label = labels[i];
+        const size_t run_start = i;
+        while(i < end && labels[i] == label)
+          i++;
+        if(use_tables)
+          table[label] += i - run_start;
+        else
+          __atomic_fetch_add(&table[label], i - run_start, __ATOMIC_RELAXED);
+      }
+    });
+  });
+
+  for(const std::vector<size_t> &chunk: chunk_counts) {
+    for(size_t label = 0; label < chunk.size(); label++)
+      counts[label] += chunk[label];
+  }
+  return counts;
+}
+
+void LabeledVoxelVolume::Remap(const std::vector<Voxel> &table) {
+  const size_t size = size_t(x_size_) * y_size_ * z_size_;
+  const Voxel max_label = table.empty() ? 0 :
+    *std::max_element(table.begin(), table.end());
+
+  // in place if the width stays the same
+  Labels remapped;
+  Labels *out_storage = &labels_;
+  if(MakeLabels(max_label, 0).index() != labels_.index()) {
+    remapped = MakeLabels(max_label, size);
+    out_storage = &remapped;
+  }
+  const int chunks = ParallelThreads();
+  std::visit([&](const auto &labels, auto &out) {
+    using OutLabel = LabelOf<decltype(out)>;
+    ParallelFor(0, chunks, [&](int chunk) {
+      const size_t end = ChunkBegin(size, chunks, chunk + 1);
+      for(size_t i = ChunkBegin(size, chunks, chunk); i < end; i++) {
+        assert(labels[i] < table.size());
+        out[i] = OutLabel(table[labels[i]]);
+      }
+    });
+  }, labels_, *out_storage);
+  if(out_storage != &labels_)
+    labels_ = std::move(remapped);
+}
+
+std::vector<LabeledVoxelVolume::Voxel> LabeledVoxelVolume::CompactLabels() {
+  const std::vector<size_t> counts = Histogram();
+  std::vector<Voxel> table(counts.size(), 0);
+  std::vector<Voxel> old_labels(1, 0);
+  for(size_t label = 1; label < counts.size(); label++) {
+    if(counts[label]) {
+      table[label] = Voxel(old_labels.size());
+      old_labels.push_back(Voxel(label));
+    }
+  }
+  Remap(table);
+  return old_labels;
+}
+
 std::ostream& operator<<(std::ostream &out, const LabeledVoxelVolume &v) {
   int max_width = 3; // TODO actually check labels for max(log10())
   const int z_size = v.XSize(), y_size = v.YSize(), x_size = v.XSize();
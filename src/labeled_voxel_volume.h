@@ -3,25 +3,80 @@
 
 #include "voxel_volume.h"
 
+#include <cstdint>
+#include <limits>
 #include <ostream>
+#include <type_traits>
+#include <utility>
+#include <variant>
 #include <vector>
 
+/*
+A VoxelVolume where each voxel is a label, with 0 meaning clear.
+
+The labels are stored as the narrowest of uint8_t, uint16_t, and uint32_t
+that holds the largest of them, so a volume with few labels costs less memory
+and bandwidth. Set() widens the storage when given a label that doesn't fit.
+Merge() and SweepXAndMerge() renumber every voxel anyway, so they store the
+result at the width its number of labels needs, wider or narrower than
+before. Get() and Set() take a Voxel, the widest type, whatever the storage.
+
+The bulk operations are templates on the stored label type, with one loop
+for each width. VisitLabels() gives code outside the class the same typed
+access.
+*/
 class LabeledVoxelVolume : public VoxelVolume {
 public:
-  using Voxel = uint16_t;
-  using VoxelPairWord = uint32_t; // a word big enough to hold 2 Voxels
-  using VoxelMaxWord = uint64_t; // a word for working on Voxels in parallel
-  static constexpr int VoxelsPerMaxWord = sizeof(VoxelMaxWord) / sizeof(Voxel);
-
-  LabeledVoxelVolume(int x_size, int y_size, int z_size);
+  using Voxel = uint32_t;
+  using Labels = std::variant<
+    std::vector<uint8_t>, std::vector<uint16_t>, std::vector<uint32_t>>;
+
+  // a volume of 0s, stored wide enough for labels up to "max_label"
+  LabeledVoxelVolume(
+    int x_size, int y_size, int z_size,
+    Voxel max_label = std::numeric_limits<uint8_t>::max());
   virtual ~LabeledVoxelVolume() {}
 
+  // Call f(labels) with the std::vector of labels, in z-major order, of
+  // whichever type they're stored as, and return what it returns. "f" must
+  // not resize the vector.
+  template<typename Func>
+  decltype(auto) VisitLabels(Func &&f) {
+    return std::visit(std::forward<Func>(f), labels_);
+  }
+
+  template<typename Func>
+  decltype(auto) VisitLabels(Func &&f) const {
+    return std::visit(std::forward<Func>(f), labels_);
+  }
+
   Voxel Get(int x, int y, int z) const {
-    return voxels_[VoxelIndex(x,y,z)];
+    const int i = VoxelIndex(x,y,z);
+    return VisitLabels([i](const auto &labels) { return Voxel(labels[i]); });
   }
 
   void Set(int x, int y, int z, Voxel v) {
-    voxels_[VoxelIndex(x,y,z)] = v;
+    if(v > MaxStorableLabel())
+      WidenLabels(v);
+    const int i = VoxelIndex(x,y,z);
+    VisitLabels([i, v](auto &labels) {
+      labels[i] = typename std::decay_t<decltype(labels)>::value_type(v);
+    });
+  }
+
+  // the size of each stored label: 1, 2, or 4 bytes
+  int LabelBytes() const {
+    return VisitLabels([](const auto &labels) {
+      return int(sizeof(labels[0]));
+    });
+  }
+
+  // the largest label the current storage can hold
+  Voxel MaxStorableLabel() const {
+    return VisitLabels([](const auto &labels) {
+      using Label = typename std::decay_t<decltype(labels)>::value_type;
+      return Voxel(std::numeric_limits<Label>::max());
+    });
   }
 
   bool GetBool(int x, int y, int z) const override;
@@ -33,22 +88,44 @@ public:
   LabeledVoxelVolume RotateY() const;
   LabeledVoxelVolume RotateZ() const;
 
+  // reflections, e.g. MirrorX moves voxel (x, y, z) to (x_size - 1 - x, y, z)
+  LabeledVoxelVolume MirrorX() const;
+  LabeledVoxelVolume MirrorY() const;
+  LabeledVoxelVolume MirrorZ() const;
+
   // overlay another volume on this one, compare each pair of overlaid voxels,
   // and generate new labels representing each unique pairing
   void Merge(const LabeledVoxelVolume &overlay);
 
   void SweepXAndMerge();
 
+  // The number of voxels with each label, up to the largest in the volume.
+  // The result has an entry for every label up to the largest, used or not,
+  // so it takes 8 bytes per label: 32 GiB if a voxel is labeled 0xFFFFFFFF.
+  // Memory besides the result is small whatever the number of threads.
+  std::vector<size_t> Histogram() const;
+
+  // Relabel every voxel v as table[v], storing the labels as narrow as the
+  // largest entry in "table" allows. "table" must have an entry for every
+  // label in the volume.
+  void Remap(const std::vector<Voxel> &table);
+
+  // Renumber the labels in use to 1, 2, ..., keeping their order, with 0
+  // staying 0, and return the old label of each new one. This keeps label
+  // ranges dense, and the tables of later Merges small, however many rounds
+  // of merging came before.
+  std::vector<Voxel> CompactLabels();
+
 private:
-  const VoxelMaxWord *VoxelsAsMaxWords() const {
-    return reinterpret_cast<const VoxelMaxWord*>(voxels_.data());
-  }
+  // store the labels wide enough for labels up to "max_label"
+  void WidenLabels(Voxel max_label);
 
-  size_t VoxelMaxWordNum() const {
-    return voxels_.size() / VoxelsPerMaxWord;
-  }
+  // a volume the same size as this one, with labels stored the same way, with
+  // f(source, dest) called on pointers to the labels of each
+  template<typename Func>
+  LabeledVoxelVolume Transformed(Func f) const;
 
-  std::vector<Voxel> voxels_;
+  Labels labels_;
 };
 
 std::ostream& operator<<(std::ostream&, const LabeledVoxelVolume&);
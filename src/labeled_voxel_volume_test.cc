@@ -0,0 +1,310 @@
+#include "labeled_voxel_volume.h"
+
+#include "catch.h"
+
+#include <map>
+#include <random>
+#include <set>
+#include <utility>
+
+namespace {
+
+using Voxel = LabeledVoxelVolume::Voxel;
+
+// a volume of random labels from 0 to "max_label", in runs along X so there
+// are repeated pairs next to each other, as in real volumes
+LabeledVoxelVolume RandomLabels(
+  int x_size, int y_size, int z_size, Voxel max_label, int seed
+) {
+  LabeledVoxelVolume v(x_size, y_size, z_size);
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> label(0, max_label);
+  for(int z = 0; z < z_size; z++) {
+    for(int y = 0; y < y_size; y++) {
+      Voxel run_label = 0;
+      for(int x = 0; x < x_size; x++) {
+        if(rng() % 4 == 0)
+          run_label = Voxel(label(rng));
+        v.Set(x, y, z, run_label);
+      }
+    }
+  }
+  return v;
+}
+
+// Merge, one voxel at a time, with a std::map
+LabeledVoxelVolume ReferenceMerge(
+  const LabeledVoxelVolume &a, const LabeledVoxelVolume &b
+) {
+  LabeledVoxelVolume merged(a.XSize(), a.YSize(), a.ZSize());
+  std::map<std::pair<Voxel, Voxel>, Voxel> labels {{{0, 0}, 0}};
+  for(int z = 0; z < a.ZSize(); z++) {
+    for(int y = 0; y < a.YSize(); y++) {
+      for(int x = 0; x < a.XSize(); x++) {
+        auto pair = std::make_pair(a.Get(x,y,z), b.Get(x,y,z));
+        auto label = labels.insert(std::make_pair(pair, labels.size())).first;
+        merged.Set(x, y, z, label->second);
+      }
+    }
+  }
+  return merged;
+}
+
+// SweepXAndMerge, with a std::map from each row's std::set of labels to its
+// class's new labels
+LabeledVoxelVolume ReferenceSweepXAndMerge(const LabeledVoxelVolume &v) {
+  LabeledVoxelVolume swept = v;
+  std::map<std::set<Voxel>, std::map<Voxel, Voxel>> classes;
+  int next_label = 1;
+  for(int z = 0; z < v.ZSize(); z++) {
+    for(int y = 0; y < v.YSize(); y++) {
+      std::set<Voxel> labels;
+      for(int x = 0; x < v.XSize(); x++)
+        labels.insert(v.Get(x,y,z));
+      if(labels == std::set<Voxel> {0})
+        continue;
+      auto c = classes.find(labels);
+      if(c == classes.end()) {
+        std::map<Voxel, Voxel> new_labels;
+        for(Voxel label: labels)
+          new_labels[label] = Voxel(next_label++);
+        c = classes.insert(std::make_pair(labels, new_labels)).first;
+      }
+      for(int x = 0; x < v.XSize(); x++)
+        swept.Set(x, y, z, c->second.at(v.Get(x,y,z)));
+    }
+  }
+  return swept;
+}
+
+bool SameLabels(const LabeledVoxelVolume &a, const LabeledVoxelVolume &b) {
+  for(int z = 0; z < a.ZSize(); z++) {
+    for(int y = 0; y < a.YSize(); y++) {
+      for(int x = 0; x < a.XSize(); x++) {
+        if(a.Get(x,y,z) != b.Get(x,y,z))
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+TEST_CASE("LabeledVoxelVolume Merge") {
+  // few labels, for the direct table, and many, for the hash map
+  for(Voxel max_label: {Voxel(1), Voxel(7), Voxel(200), Voxel(5000)}) {
+    LabeledVoxelVolume a = RandomLabels(36, 20, 17, max_label, 1);
+    LabeledVoxelVolume b = RandomLabels(36, 20, 17, max_label, 2);
+    LabeledVoxelVolume expected = ReferenceMerge(a, b);
+    a.Merge(b);
+    REQUIRE(SameLabels(a, expected));
+  }
+
+  // merging with an empty volume renumbers in order of first appearance
+  LabeledVoxelVolume a(4, 1, 1), empty(4, 1, 1);
+  a.Set(0, 0, 0, 9);
+  a.Set(1, 0, 0, 3);
+  a.Set(3, 0, 0, 9);
+  a.Merge(empty);
+  REQUIRE(a.Get(0, 0, 0) == 1);
+  REQUIRE(a.Get(1, 0, 0) == 2);
+  REQUIRE(a.Get(2, 0, 0) == 0);
+  REQUIRE(a.Get(3, 0, 0) == 1);
+}
+
+TEST_CASE("LabeledVoxelVolume Merge widens and narrows labels") {
+  // every voxel is a different pair, which takes 32-bit labels
+  LabeledVoxelVolume a(64, 64, 32), b(64, 64, 32);
+  for(int z = 0; z < 32; z++) {
+    for(int y = 0; y < 64; y++) {
+      for(int x = 0; x < 64; x++) {
+        a.Set(x, y, z, Voxel(x + 64 * (z % 4)));
+        b.Set(x, y, z, Voxel(y + 64 * (z / 4)));
+      }
+    }
+  }
+  REQUIRE(a.LabelBytes() == 1);
+  REQUIRE(b.LabelBytes() == 2);
+  LabeledVoxelVolume expected = ReferenceMerge(a, b);
+  a.Merge(b);
+  REQUIRE(a.LabelBytes() == 4);
+  REQUIRE(SameLabels(a, expected));
+  REQUIRE(a.Get(63, 63, 31) == 64 * 64 * 32 - 1);
+
+  // few labels, however wide they were stored
+  LabeledVoxelVolume wide(8, 2, 2, 100000), empty(8, 2, 2);
+  REQUIRE(wide.LabelBytes() == 4);
+  wide.Set(1, 0, 0, 70000);
+  wide.Set(2, 1, 1, 99999);
+  wide.Merge(empty);
+  REQUIRE(wide.LabelBytes() == 1);
+  REQUIRE(wide.Get(1, 0, 0) == 1);
+  REQUIRE(wide.Get(2, 1, 1) == 2);
+  REQUIRE(wide.Get(0, 0, 0) == 0);
+}
+
+TEST_CASE("LabeledVoxelVolume SweepXAndMerge") {
+  // few labels, so row classes repeat, and many, so they mostly don't
+  for(Voxel max_label: {Voxel(1), Voxel(3), Voxel(1000)}) {
+    LabeledVoxelVolume v = RandomLabels(12, 30, 21, max_label, 3);
+    // some empty rows
+    for(int x = 0; x < 12; x++) {
+      v.Set(x, 4, 0, 0);
+      v.Set(x, 29, 20, 0);
+    }
+    LabeledVoxelVolume expected = ReferenceSweepXAndMerge(v);
+    v.SweepXAndMerge();
+    REQUIRE(SameLabels(v, expected));
+  }
+
+  // every row is its own class of 64 labels, which takes 32-bit labels
+  LabeledVoxelVolume many(64, 64, 20);
+  for(int z = 0; z < 20; z++) {
+    for(int y = 0; y < 64; y++) {
+      for(int x = 0; x < 64; x++)
+        many.Set(x, y, z, Voxel(x + y + 64 * z));
+    }
+  }
+  REQUIRE(many.LabelBytes() == 2);
+  LabeledVoxelVolume expected = ReferenceSweepXAndMerge(many);
+  many.SweepXAndMerge();
+  REQUIRE(many.LabelBytes() == 4);
+  REQUIRE(SameLabels(many, expected));
+
+  // and back down, to 1 row class of 1 label
+  LabeledVoxelVolume wide(8, 4, 4, 100000);
+  for(int y = 0; y < 4; y++)
+    wide.Set(0, y, 2, 99999);
+  expected = ReferenceSweepXAndMerge(wide);
+  wide.SweepXAndMerge();
+  REQUIRE(wide.LabelBytes() == 1);
+  REQUIRE(SameLabels(wide, expected));
+  REQUIRE(wide.Get(0, 3, 2) == 2);
+  REQUIRE(wide.Get(1, 3, 2) == 1);
+  REQUIRE(wide.Get(1, 3, 1) == 0);
+}
+
+TEST_CASE("LabeledVoxelVolume rotations and mirrors") {
+  // more than 2 tiles at any label width, but not a whole number of them
+  const int n = 132;
+  const int m = 12;
+
+  // With each voxel numbered, any misplaced voxel shows. The numbers take 32
+  // bits, so numbering them mod 256 and mod 1<<16 checks 8 and 16-bit labels
+  // too.
+  auto numbered = [](int x_size, int y_size, int z_size, int modulus) {
+    LabeledVoxelVolume v(x_size, y_size, z_size);
+    for(int z = 0; z < z_size; z++) {
+      for(int y = 0; y < y_size; y++) {
+        for(int x = 0; x < x_size; x++)
+          v.Set(x, y, z, Voxel((z * y_size + y) * x_size + x) % modulus);
+      }
+    }
+    return v;
+  };
+
+  auto check = [](
+    const LabeledVoxelVolume &v, const LabeledVoxelVolume &moved,
+    auto to_x, auto to_y, auto to_z
+  ) {
+    for(int z = 0; z < v.ZSize(); z++) {
+      for(int y = 0; y < v.YSize(); y++) {
+        for(int x = 0; x < v.XSize(); x++) {
+          if(moved.Get(to_x(x,y,z), to_y(x,y,z), to_z(x,y,z)) != v.Get(x,y,z))
+            return false;
+        }
+      }
+    }
+    return true;
+  };
+
+  for(int modulus: {1 << 8, 1 << 16, 1 << 30}) {
+    const int label_bytes =
+      (modulus == 1 << 8 ? 1 : modulus == 1 << 16 ? 2 : 4);
+    LabeledVoxelVolume v = numbered(m, n, n, modulus);
+    REQUIRE(v.LabelBytes() == label_bytes);
+    REQUIRE(check(v, v.RotateX(),
+      [](int x, int, int) { return x; },
+      [&](int, int, int z) { return n - 1 - z; },
+      [](int, int y, int) { return y; }));
+
+    v = numbered(n, m, n, modulus);
+    REQUIRE(check(v, v.RotateY(),
+      [](int, int, int z) { return z; },
+      [](int, int y, int) { return y; },
+      [&](int x, int, int) { return n - 1 - x; }));
+
+    v = numbered(n, n, m, modulus);
+    REQUIRE(check(v, v.RotateZ(),
+      [&](int, int y, int) { return n - 1 - y; },
+      [](int x, int, int) { return x; },
+      [](int, int, int z) { return z; }));
+
+    v = numbered(m, 10, 6, modulus);
+    auto same_x = [](int x, int, int) { return x; };
+    auto same_y = [](int, int y, int) { return y; };
+    auto same_z = [](int, int, int z) { return z; };
+    REQUIRE(check(v, v.MirrorX(),
+      [&](int x, int, int) { return m - 1 - x; }, same_y, same_z));
+    REQUIRE(check(v, v.MirrorY(),
+      same_x, [](int, int y, int) { return 9 - y; }, same_z));
+    REQUIRE(check(v, v.MirrorZ(),
+      same_x, same_y, [](int, int, int z) { return 5 - z; }));
+  }
+}
+
+TEST_CASE("LabeledVoxelVolume Histogram, Remap, and CompactLabels") {
+  LabeledVoxelVolume v = RandomLabels(20, 9, 14, 30, 4);
+  v.Set(3, 4, 5, 100000);
+  REQUIRE(v.LabelBytes() == 4);
+
+  std::vector<size_t> expected(100001);
+  for(int z = 0; z < v.ZSize(); z++) {
+    for(int y = 0; y < v.YSize(); y++) {
+      for(int x = 0; x < v.XSize(); x++)
+        expected[v.Get(x,y,z)]++;
+    }
+  }
+  REQUIRE(v.Histogram() == expected);
+
+  // compaction keeps the order of labels, and narrows them
+  const LabeledVoxelVolume original = v;
+  std::vector<Voxel> old_labels = v.CompactLabels();
+  REQUIRE(v.LabelBytes() == 1);
+  REQUIRE(old_labels.back() == 100000);
+  REQUIRE(v.Get(3, 4, 5) == old_labels.size() - 1);
+  for(size_t label = 1; label < old_labels.size(); label++)
+    REQUIRE(old_labels[label - 1] < old_labels[label]);
+  for(int z = 0; z < v.ZSize(); z++) {
+    for(int y = 0; y < v.YSize(); y++) {
+      for(int x = 0; x < v.XSize(); x++)
+        REQUIRE(old_labels[v.Get(x,y,z)] == original.Get(x,y,z));
+    }
+  }
+
+  // and Remap undoes it, widening them again
+  v.Remap(old_labels);
+  REQUIRE(v.LabelBytes() == 4);
+  REQUIRE(SameLabels(v, original));
+
+  // labels too big for a table per thread are counted in the result itself
+  LabeledVoxelVolume sparse = RandomLabels(30, 20, 10, 30, 5);
+  const Voxel big = (1 << 21) + 5;
+  sparse.Set(0, 0, 0, big);
+  sparse.Set(29, 19, 9, big);
+  sparse.Set(7, 8, 9, big - 1);
+  std::vector<size_t> sparse_expected(big + 1);
+  for(int z = 0; z < sparse.ZSize(); z++) {
+    for(int y = 0; y < sparse.YSize(); y++) {
+      for(int x = 0; x < sparse.XSize(); x++)
+        sparse_expected[sparse.Get(x,y,z)]++;
+    }
+  }
+  REQUIRE(sparse.Histogram() == sparse_expected);
+
+  // an empty volume is all label 0
+  LabeledVoxelVolume empty(8, 2, 3);
+  REQUIRE(empty.Histogram() == std::vector<size_t> {48});
+  REQUIRE(empty.CompactLabels() == std::vector<Voxel> {0});
+}
@@ -0,0 +1,118 @@
+#ifndef MESH_TEST_UTIL_H
+#define MESH_TEST_UTIL_H
+
+#include "math/vector.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Checks on meshes for the tests of the code that makes them.
+
+// whether two meshes have the same vertices and triangles, in the same order
+inline bool SameMesh(const TriMesh &a, const TriMesh &b) {
+  if(a.verts.size() != b.verts.size() || a.tris.size() != b.tris.size() ||
+     a.normals.size() != b.normals.size())
+    return false;
+  for(size_t i = 0; i < a.verts.size(); i++) {
+    if(a.verts[i] != b.verts[i])
+      return false;
+  }
+  for(size_t i = 0; i < a.normals.size(); i++) {
+    if(a.normals[i] != b.normals[i])
+      return false;
+  }
+  for(size_t i = 0; i < a.tris.size(); i++) {
+    const Tri &ta = a.tris[i], &tb = b.tris[i];
+    for(int j = 0; j < 3; j++) {
+      if(ta.vert_idxs[j] != tb.vert_idxs[j] ||
+         ta.normal_idxs[j] != tb.normal_idxs[j])
+        return false;
+    }
+    if(ta.color.r != tb.color.r || ta.color.g != tb.color.g ||
+       ta.color.b != tb.color.b)
+      return false;
+  }
+  return true;
+}
+
+// a triangle by the positions of its vertices, starting from the least, and
+// the axis and sign of its normal
+using MeshTriangle =
+  std::pair<std::array<std::tuple<float, float, float>, 3>, int>;
+
+// the triangles of a mesh of axis-aligned faces, e.g. a block mesh, sorted
+inline std::vector<MeshTriangle> SortedTriangles(const TriMesh &mesh) {
+  std::vector<MeshTriangle> tris;
+  for(const Tri &tri: mesh.tris) {
+    MeshTriangle::first_type corners;
+    for(int i = 0; i < 3; i++) {
+      const Vector3f &v = mesh.verts[tri.vert_idxs[i]];
+      corners[i] = std::make_tuple(v.x, v.y, v.z);
+    }
+    std::rotate(corners.begin(),
+      std::min_element(corners.begin(), corners.end()), corners.end());
+    const Vector3f &normal = mesh.normals[tri.normal_idxs[0]];
+    const int axis = (normal.x ? 0 : normal.y ? 1 : 2) * 2 +
+      (normal.x + normal.y + normal.z > 0);
+    tris.emplace_back(corners, axis);
+  }
+  std::sort(tris.begin(), tris.end());
+  return tris;
+}
+
+// whether two meshes of axis-aligned faces have the same triangles, however
+// their vertices and triangles are numbered and ordered
+inline bool SameSurface(const TriMesh &a, const TriMesh &b) {
+  return SortedTriangles(a) == SortedTriangles(b);
+}
+
+// Whether "mesh" is closed, with no cracks or T-junctions, and consistently
+// wound: every edge from vertex a to b is matched by one from b to a.
+inline bool IsWatertight(const TriMesh &mesh) {
+  std::map<std::pair<int, int>, int> edges;
+  for(const Tri &tri: mesh.tris) {
+    for(int i = 0; i < 3; i++) {
+      const int a = tri.vert_idxs[i], b = tri.vert_idxs[(i + 1) % 3];
+      edges[std::make_pair(a, b)]++;
+      edges[std::make_pair(b, a)]--;
+    }
+  }
+  for(const auto &edge: edges) {
+    if(edge.second != 0)
+      return false;
+  }
+  return true;
+}
+
+// the volume "mesh" encloses, by the divergence theorem, which is only right
+// if every triangle faces outward
+inline double EnclosedVolume(const TriMesh &mesh) {
+  double volume = 0;
+  for(const Tri &tri: mesh.tris) {
+    const Vector3f &a = mesh.verts[tri.vert_idxs[0]];
+    const Vector3f &b = mesh.verts[tri.vert_idxs[1]];
+    const Vector3f &c = mesh.verts[tri.vert_idxs[2]];
+    volume += dot(Vector3d {a.x, a.y, a.z},
+      cross(Vector3d {b.x, b.y, b.z}, Vector3d {c.x, c.y, c.z})) / 6;
+  }
+  return volume;
+}
+
+// whether each triangle of "mesh" faces the way its normal does
+inline bool NormalsMatch(const TriMesh &mesh) {
+  for(const Tri &tri: mesh.tris) {
+    const Vector3f &a = mesh.verts[tri.vert_idxs[0]];
+    const Vector3f &b = mesh.verts[tri.vert_idxs[1]];
+    const Vector3f &c = mesh.verts[tri.vert_idxs[2]];
+    if(!(dot(cross(b - a, c - a), mesh.normals[tri.normal_idxs[0]]) > 0))
+      return false;
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// number of threads ParallelFor uses: one per hardware thread
+inline int ParallelThreads() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// the start of part "i" of [begin, end) split into "parts" nearly equal
+// contiguous parts; part i is [SplitRange(.., i), SplitRange(.., i + 1))
+inline int SplitRange(int begin, int end, int parts, int i) {
+  return begin + int((long long)(end - begin) * i / parts);
+}
+
+/*
+Call f(i) for every i in [begin, end), in parallel, and return once all calls
+have finished. The range is split into up to ParallelThreads() contiguous
+chunks, and each chunk runs on its own thread, in increasing order of i. A
+range of 1 runs on the calling thread.
+
+Threads are started per call, so each i should stand for a good amount of work,
+e.g. a slab of a volume rather than a voxel. "f" must not throw.
+*/
+template<typename Func>
+void ParallelFor(int begin, int end, Func f) {
+  const int chunks = std::min(end - begin, ParallelThreads());
+  if(chunks <= 1) {
+    for(int i = begin; i < end; i++)
+      f(i);
+    return;
+  }
+
+  auto run_chunk = [&](int chunk) {
+    const int chunk_end = SplitRange(begin, end, chunks, chunk + 1);
+    for(int i = SplitRange(begin, end, chunks, chunk); i < chunk_end; i++)
+      f(i);
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(chunks - 1);
+  for(int chunk = 1; chunk < chunks; chunk++)
+    threads.emplace_back(run_chunk, chunk);
+  run_chunk(0);
+  for(std::thread &thread: threads)
+    thread.join();
+}
+
+#endif
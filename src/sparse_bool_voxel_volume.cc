@@ -0,0 +1,336 @@
+#include "sparse_bool_voxel_volume.h"
+
+#include "bit_transpose.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+using Brick = SparseBoolVoxelVolume::Brick;
+constexpr int BrickSize = SparseBoolVoxelVolume::BrickSize;
+
+const Brick AllZeroBrick = {};
+const Brick AllOneBrick = {
+  ~0ull, ~0ull, ~0ull, ~0ull, ~0ull, ~0ull, ~0ull, ~0ull
+};
+
+// byte "i" of "word", and "word" with byte "i" replaced by "byte"
+uint64_t GetByte(uint64_t word, int i) {
+  return (word >> (i * 8)) & 0xff;
+}
+
+uint64_t SetByte(uint64_t word, int i, uint64_t byte) {
+  return (word & ~(0xffull << (i * 8))) | (byte << (i * 8));
+}
+
+// Operations on an 8x8 bit matrix, stored as in a brick layer: byte y is row
+// y, and bit x of that byte is column x.
+
+// bit x of row y becomes bit y of row x
+uint64_t Transpose8x8(uint64_t m) {
+  uint8_t rows[BrickSize];
+  for(int y = 0; y < BrickSize; y++)
+    rows[y] = uint8_t(GetByte(m, y));
+  TransposeBits(rows);
+  uint64_t transposed = 0;
+  for(int y = 0; y < BrickSize; y++)
+    transposed |= uint64_t(rows[y]) << (y * 8);
+  return transposed;
+}
+
+// column x becomes column 7 - x
+uint64_t FlipColumns8x8(uint64_t m) {
+  m = ((m >> 1) & 0x5555555555555555ull) | ((m & 0x5555555555555555ull) << 1);
+  m = ((m >> 2) & 0x3333333333333333ull) | ((m & 0x3333333333333333ull) << 2);
+  m = ((m >> 4) & 0x0f0f0f0f0f0f0f0full) | ((m & 0x0f0f0f0f0f0f0f0full) << 4);
+  return m;
+}
+
+// row y becomes row 7 - y
+uint64_t FlipRows8x8(uint64_t m) {
+  m = ((m >> 8) & 0x00ff00ff00ff00ffull) | ((m & 0x00ff00ff00ff00ffull) << 8);
+  m = ((m >> 16) & 0x0000ffff0000ffffull) | ((m & 0x0000ffff0000ffffull) << 16);
+  m = (m >> 32) | (m << 32);
+  return m;
+}
+
+// Quarter rotations of a single brick, matching the BoolVoxelVolume rotations
+// within it. Each maps local voxel (x, y, z) to:
+
+// (x, 7 - z, y)
+Brick RotateBrickX(const Brick &brick) {
+  Brick rotated;
+  for(int z = 0; z < BrickSize; z++) {
+    uint64_t layer = 0;
+    for(int y = 0; y < BrickSize; y++)
+      layer = SetByte(layer, y, GetByte(brick[BrickSize - 1 - y], z));
+    rotated[z] = layer;
+  }
+  return rotated;
+}
+
+// (z, y, 7 - x)
+Brick RotateBrickY(const Brick &brick) {
+  Brick rotated = {};
+  for(int y = 0; y < BrickSize; y++) {
+    // the XZ plane at y, as a matrix with row z, column x
+    uint64_t plane = 0;
+    for(int z = 0; z < BrickSize; z++)
+      plane = SetByte(plane, z, GetByte(brick[z], y));
+    plane = FlipRows8x8(Transpose8x8(plane));
+    for(int z = 0; z < BrickSize; z++)
+      rotated[z] = SetByte(rotated[z], y, GetByte(plane, z));
+  }
+  return rotated;
+}
+
+// (7 - y, x, z)
+Brick RotateBrickZ(const Brick &brick) {
+  Brick rotated;
+  for(int z = 0; z < BrickSize; z++)
+    rotated[z] = FlipColumns8x8(Transpose8x8(brick[z]));
+  return rotated;
+}
+
+} // namespace
+
+SparseBoolVoxelVolume::SparseBoolVoxelVolume(
+  int x_size, int y_size, int z_size
+) :
+  VoxelVolume(x_size, y_size, z_size),
+  x_bricks_(x_size / BrickSize),
+  y_bricks_(y_size / BrickSize),
+  z_bricks_(z_size / BrickSize),
+  directory_(size_t(x_bricks_) * y_bricks_ * z_bricks_, EmptyBrick)
+{
+  assert(x_size % BrickSize == 0);
+  assert(y_size % BrickSize == 0);
+  assert(z_size % BrickSize == 0);
+}
+
+SparseBoolVoxelVolume::SparseBoolVoxelVolume(const BoolVoxelVolume &dense) :
+  SparseBoolVoxelVolume(dense.XSize(), dense.YSize(), dense.ZSize())
+{
+  using VoxelWord = BoolVoxelVolume::VoxelWord;
+  constexpr int VoxelsPerWord = BoolVoxelVolume::VoxelsPerWord;
+  const VoxelWord *words = dense.GetVoxels().data();
+  const int x_words = dense.XWords();
+
+  int i = 0;
+  for(int bz = 0; bz < z_bricks_; bz++) {
+    for(int by = 0; by < y_bricks_; by++) {
+      for(int bx = 0; bx < x_bricks_; bx++, i++) {
+        // each brick row is 8 bits of one dense word
+        const int x = bx * BrickSize;
+        Brick brick = {};
+        for(int z = 0; z < BrickSize; z++) {
+          for(int y = 0; y < BrickSize; y++) {
+            const int row = (bz * BrickSize + z) * y_size_ + by * BrickSize + y;
+            uint64_t byte = (words[row * x_words + x / VoxelsPerWord] >>
+              (x % VoxelsPerWord)) & 0xff;
+            brick[z] |= byte << (y * 8);
+          }
+        }
+        directory_[i] = AddBrick(brick);
+      }
+    }
+  }
+}
+
+void SparseBoolVoxelVolume::Set(int x, int y, int z) {
+  int32_t &entry = directory_[BrickIndex(x,y,z)];
+  if(entry == FullBrick)
+    return;
+  if(entry == EmptyBrick) {
+    entry = int32_t(bricks_.size());
+    bricks_.push_back(AllZeroBrick);
+  }
+  bricks_[entry][z % BrickSize] |= uint64_t(1) << BitIndex(x,y);
+}
+
+bool SparseBoolVoxelVolume::GetBool(int x, int y, int z) const /*override*/ {
+  return Get(x,y,z);
+}
+
+Color SparseBoolVoxelVolume::GetColor(int x, int y, int z) const /*override*/ {
+  return Color::White;
+}
+
+bool SparseBoolVoxelVolume::IsEmpty() const {
+  // stored bricks are never all 0: Set sets a bit in each one it stores, and
+  // AddBrick turns all-0 bricks into EmptyBrick
+  return std::all_of(directory_.begin(), directory_.end(),
+    [](int32_t entry) { return entry == EmptyBrick; });
+}
+
+BoolVoxelVolume SparseBoolVoxelVolume::ToBoolVoxelVolume() const {
+  using VoxelWord = BoolVoxelVolume::VoxelWord;
+  constexpr int VoxelsPerWord = BoolVoxelVolume::VoxelsPerWord;
+  BoolVoxelVolume dense(x_size_, y_size_, z_size_);
+  VoxelWord *words = dense.MutableVoxels();
+  const int x_words = dense.XWords();
+
+  int i = 0;
+  for(int bz = 0; bz < z_bricks_; bz++) {
+    for(int by = 0; by < y_bricks_; by++) {
+      for(int bx = 0; bx < x_bricks_; bx++, i++) {
+        if(directory_[i] == EmptyBrick)
+          continue;
+        const Brick &brick = BrickAt(directory_[i]);
+        const int x = bx * BrickSize;
+        for(int z = 0; z < BrickSize; z++) {
+          for(int y = 0; y < BrickSize; y++) {
+            const int row = (bz * BrickSize + z) * y_size_ + by * BrickSize + y;
+            words[row * x_words + x / VoxelsPerWord] |=
+              VoxelWord(GetByte(brick[z], y)) << (x % VoxelsPerWord);
+          }
+        }
+      }
+    }
+  }
+  return dense;
+}
+
+int32_t SparseBoolVoxelVolume::AddBrick(const Brick &brick) {
+  if(brick == AllZeroBrick)
+    return EmptyBrick;
+  if(brick == AllOneBrick)
+    return FullBrick;
+  bricks_.push_back(brick);
+  return int32_t(bricks_.size() - 1);
+}
+
+const SparseBoolVoxelVolume::Brick& SparseBoolVoxelVolume::BrickAt(
+  int32_t entry
+) const {
+  if(entry == EmptyBrick)
+    return AllZeroBrick;
+  if(entry == FullBrick)
+    return AllOneBrick;
+  return bricks_[entry];
+}
+
+template<typename BrickOp>
+SparseBoolVoxelVolume SparseBoolVoxelVolume::Combine(
+  const SparseBoolVoxelVolume &b, BrickOp op
+) const {
+  assert(SameSize(b));
+  SparseBoolVoxelVolume c(x_size_, y_size_, z_size_);
+  c.bricks_.reserve(std::max(bricks_.size(), b.bricks_.size()));
+
+  for(size_t i = 0; i < directory_.size(); i++) {
+    const int32_t a_entry = directory_[i];
+    const int32_t b_entry = b.directory_[i];
+    if(a_entry < 0 && b_entry < 0) {
+      // both are flags, so the result is too: apply the op to a single word
+      // from each
+      const uint64_t word = op(BrickAt(a_entry)[0], b.BrickAt(b_entry)[0]);
+      c.directory_[i] = (word ? FullBrick : EmptyBrick);
+      continue;
+    }
+    if(a_entry < 0 || b_entry < 0) {
+      // One is a flag, so each bit of the result depends only on the same
+      // bit of the stored brick. The op on words of all 0s and all 1s says
+      // how: the same either way makes a flag (e.g. Empty & x, Full | x);
+      // the stored bit copies the brick (e.g. Empty | x, Full & x, x & ~Empty);
+      // only its complement (Full & ~x) is computed word by word below.
+      const bool a_is_flag = (a_entry < 0);
+      const uint64_t flag =
+        (a_is_flag ? BrickAt(a_entry) : b.BrickAt(b_entry))[0];
+      auto with_stored = [&](uint64_t stored) {
+        return a_is_flag ? op(flag, stored) : op(stored, flag);
+      };
+      const uint64_t if_0 = with_stored(0);
+      const uint64_t if_1 = with_stored(~uint64_t(0));
+      if(if_0 == if_1) {
+        c.directory_[i] = (if_0 ? FullBrick : EmptyBrick);
+        continue;
+      }
+      if(if_0 == 0) {
+        c.directory_[i] = int32_t(c.bricks_.size());
+        c.bricks_.push_back(a_is_flag ? b.bricks_[b_entry] : bricks_[a_entry]);
+        continue;
+      }
+    }
+    const Brick &a_brick = BrickAt(a_entry);
+    const Brick &b_brick = b.BrickAt(b_entry);
+    Brick c_brick;
+    for(int z = 0; z < BrickSize; z++)
+      c_brick[z] = op(a_brick[z], b_brick[z]);
+    c.directory_[i] = c.AddBrick(c_brick);
+  }
+  return c;
+}
+
+// c = a | b
+SparseBoolVoxelVolume SparseBoolVoxelVolume::Union(
+  const SparseBoolVoxelVolume &b
+) const {
+  return Combine(b, [](uint64_t a, uint64_t b) { return a | b; });
+}
+
+// c = a & b
+SparseBoolVoxelVolume SparseBoolVoxelVolume::Intersect(
+  const SparseBoolVoxelVolume &b
+) const {
+  return Combine(b, [](uint64_t a, uint64_t b) { return a & b; });
+}
+
+// c = a & ~b
+SparseBoolVoxelVolume SparseBoolVoxelVolume::Subtract(
+  const SparseBoolVoxelVolume &b
+) const {
+  return Combine(b, [](uint64_t a, uint64_t b) { return a & ~b; });
+}
+
+template<typename ToBrick, typename RotateBrick>
+SparseBoolVoxelVolume SparseBoolVoxelVolume::RotateBricks(
+  ToBrick to_brick, RotateBrick rotate_brick
+) const {
+  SparseBoolVoxelVolume rotated(x_size_, y_size_, z_size_);
+  rotated.bricks_.reserve(bricks_.size());
+
+  int i = 0;
+  for(int bz = 0; bz < z_bricks_; bz++) {
+    for(int by = 0; by < y_bricks_; by++) {
+      for(int bx = 0; bx < x_bricks_; bx++, i++) {
+        const int32_t entry = directory_[i];
+        int32_t &rotated_entry = rotated.directory_[to_brick(bx, by, bz)];
+        if(entry < 0)
+          rotated_entry = entry;
+        else
+          rotated_entry = rotated.AddBrick(rotate_brick(bricks_[entry]));
+      }
+    }
+  }
+  return rotated;
+}
+
+SparseBoolVoxelVolume SparseBoolVoxelVolume::RotateX() const {
+  assert(y_size_ == z_size_);
+  const int n = y_bricks_, x_bricks = x_bricks_;
+  return RotateBricks(
+    [&](int bx, int by, int bz) {
+      return (by * n + n - 1 - bz) * x_bricks + bx;
+    },
+    RotateBrickX);
+}
+
+SparseBoolVoxelVolume SparseBoolVoxelVolume::RotateY() const {
+  assert(x_size_ == z_size_);
+  const int n = x_bricks_, y_bricks = y_bricks_;
+  return RotateBricks(
+    [&](int bx, int by, int bz) {
+      return ((n - 1 - bx) * y_bricks + by) * n + bz;
+    },
+    RotateBrickY);
+}
+
+SparseBoolVoxelVolume SparseBoolVoxelVolume::RotateZ() const {
+  assert(x_size_ == y_size_);
+  const int n = x_bricks_;
+  return RotateBricks(
+    [&](int bx, int by, int bz) { return (bz * n + bx) * n + n - 1 - by; },
+    RotateBrickZ);
+}
@@ -0,0 +1,131 @@
+#ifndef SPARSE_BOOL_VOXEL_VOLUME_H
+#define SPARSE_BOOL_VOXEL_VOLUME_H
+
+#include "bool_voxel_volume.h"
+#include "voxel_volume.h"
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+/*
+A VoxelVolume where each voxel is a bool value, stored sparsely.
+
+The volume is divided into bricks of BrickSize^3 = 8x8x8 voxels. A directory,
+with one entry per brick in z-major order, says whether each brick is empty
+(all 0), full (all 1), or stored in bricks_. Only the last kind costs more than
+the directory entry, so a mostly empty (or mostly solid) volume takes a small
+fraction of a dense BoolVoxelVolume's N^3/8 bytes.
+
+A Brick is 8 uint64_t, one per z layer within the brick. Within each layer,
+byte y holds row y, and bit x of that byte is voxel x:
+
+  Get(x, y, z) = (brick[z] >> (y * 8 + x)) & 1   (x, y, z within the brick)
+
+So an 8x8 layer is a 64-bit matrix, and rotating a brick is a few 8x8 bit
+transposes.
+
+Every dimension must be a multiple of BrickSize, so bricks never overhang the
+edge of the volume.
+
+Set() fills in bricks as needed but never turns them back into directory
+flags. The results of the boolean ops and rotations are normalized: a stored
+brick is never all 0 or all 1.
+*/
+class SparseBoolVoxelVolume : public VoxelVolume {
+public:
+  static constexpr int BrickSize = 8;
+  using Brick = std::array<uint64_t, BrickSize>;
+
+  // directory entries other than these are indices into bricks_
+  static constexpr int32_t EmptyBrick = -1;
+  static constexpr int32_t FullBrick = -2;
+
+  SparseBoolVoxelVolume(int x_size, int y_size, int z_size);
+  explicit SparseBoolVoxelVolume(const BoolVoxelVolume &dense);
+  virtual ~SparseBoolVoxelVolume() {}
+
+  bool Get(int x, int y, int z) const {
+    int32_t entry = directory_[BrickIndex(x,y,z)];
+    if(entry < 0)
+      return entry == FullBrick;
+    return (bricks_[entry][z % BrickSize] >> BitIndex(x,y)) & 1;
+  }
+
+  // set a voxel to 1
+  void Set(int x, int y, int z);
+
+  bool GetBool(int x, int y, int z) const override;
+  Color GetColor(int x, int y, int z) const override;
+
+  bool IsEmpty() const;
+
+  // number of bricks in each dimension
+  int XBricks() const { return x_bricks_; }
+  int YBricks() const { return y_bricks_; }
+  int ZBricks() const { return z_bricks_; }
+
+  // number of bricks stored in full, i.e. neither empty nor full
+  size_t NumStoredBricks() const { return bricks_.size(); }
+
+  BoolVoxelVolume ToBoolVoxelVolume() const;
+
+  SparseBoolVoxelVolume RotateX() const; // quarter rotation around X-axis
+  SparseBoolVoxelVolume RotateY() const;
+  SparseBoolVoxelVolume RotateZ() const;
+
+  // A brick that's empty or full in either operand costs a directory lookup,
+  // plus a copy where the result is the other operand's stored brick, e.g.
+  // in Union with an empty brick. Only bricks stored in both, and stored
+  // bricks subtracted from full ones, are combined word by word.
+  SparseBoolVoxelVolume Union(const SparseBoolVoxelVolume&) const;
+  SparseBoolVoxelVolume Intersect(const SparseBoolVoxelVolume&) const;
+  SparseBoolVoxelVolume Subtract(const SparseBoolVoxelVolume&) const;
+
+  bool SameSize(const SparseBoolVoxelVolume &other) const {
+    return x_size_ == other.x_size_ && y_size_ == other.y_size_ &&
+      z_size_ == other.z_size_;
+  }
+
+private:
+  int BrickIndex(int x, int y, int z) const {
+    assert(x >= 0); assert(x < x_size_);
+    assert(y >= 0); assert(y < y_size_);
+    assert(z >= 0); assert(z < z_size_);
+    return ((z / BrickSize) * y_bricks_ + y / BrickSize) * x_bricks_ +
+      x / BrickSize;
+  }
+
+  static int BitIndex(int x, int y) {
+    return (y % BrickSize) * BrickSize + x % BrickSize;
+  }
+
+  // the directory entry for "brick": a flag if it's all 0 or all 1, else the
+  // index of a copy of it appended to bricks_
+  int32_t AddBrick(const Brick &brick);
+
+  // the contents of the brick with directory entry "entry"
+  const Brick& BrickAt(int32_t entry) const;
+
+  // apply a boolean op brick by brick; see Union
+  template<typename BrickOp>
+  SparseBoolVoxelVolume Combine(
+    const SparseBoolVoxelVolume &b, BrickOp op) const;
+
+  // move brick (x, y, z) to ToBrick(x, y, z), rotating its contents with
+  // RotateBrick
+  template<typename ToBrick, typename RotateBrick>
+  SparseBoolVoxelVolume RotateBricks(
+    ToBrick to_brick, RotateBrick rotate_brick) const;
+
+  int x_bricks_, y_bricks_, z_bricks_;
+
+  // one entry per brick, in z-major order: EmptyBrick, FullBrick, or an index
+  // into bricks_
+  std::vector<int32_t> directory_;
+
+  std::vector<Brick> bricks_;
+};
+
+#endif
@@ -0,0 +1,127 @@
+#include "sparse_bool_voxel_volume.h"
+
+#include "bool_voxel_expr.h"
+
+#include "catch.h"
+
+#include <random>
+#include <vector>
+
+namespace {
+
+// A reproducible pattern with every kind of brick: empty, full, and partly
+// filled. Brick (bx, by, bz) is full if (bx + by + bz) % 4 == 0, partly filled
+// at random if it's 1, and empty otherwise.
+BoolVoxelVolume PatternVolume(int x_size, int y_size, int z_size, int seed) {
+  const int b = SparseBoolVoxelVolume::BrickSize;
+  BoolVoxelVolume v(x_size, y_size, z_size);
+  std::mt19937 rng(seed);
+  for(int z = 0; z < z_size; z++) {
+    for(int y = 0; y < y_size; y++) {
+      for(int x = 0; x < x_size; x++) {
+        int kind = (x / b + y / b + z / b + seed) % 4;
+        if(kind == 0 || (kind == 1 && (rng() & 1)))
+          v.Set(x,y,z);
+      }
+    }
+  }
+  return v;
+}
+
+bool SameVoxels(const SparseBoolVoxelVolume &a, const BoolVoxelVolume &b) {
+  if(a.XSize() != b.XSize() || a.YSize() != b.YSize() ||
+     a.ZSize() != b.ZSize())
+    return false;
+  for(int z = 0; z < a.ZSize(); z++) {
+    for(int y = 0; y < a.YSize(); y++) {
+      for(int x = 0; x < a.XSize(); x++) {
+        if(a.Get(x,y,z) != b.Get(x,y,z))
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+TEST_CASE("SparseBoolVoxelVolume Get/Set and conversions") {
+  SparseBoolVoxelVolume v(16, 24, 8);
+  REQUIRE(v.IsEmpty());
+  REQUIRE(v.NumStoredBricks() == 0);
+
+  v.Set(0, 0, 0);
+  v.Set(15, 23, 7);
+  v.Set(3, 9, 2);
+  v.Set(3, 9, 2);
+  REQUIRE(!v.IsEmpty());
+  REQUIRE(v.NumStoredBricks() == 3);
+  REQUIRE(v.Get(0, 0, 0));
+  REQUIRE(v.Get(15, 23, 7));
+  REQUIRE(v.Get(3, 9, 2));
+  REQUIRE(!v.Get(1, 0, 0));
+  REQUIRE(!v.Get(3, 9, 3));
+
+  BoolVoxelVolume dense = v.ToBoolVoxelVolume();
+  REQUIRE(SameVoxels(v, dense));
+
+  // empty and full bricks become directory flags
+  BoolVoxelVolume pattern = PatternVolume(40, 16, 24, 0);
+  SparseBoolVoxelVolume sparse(pattern);
+  REQUIRE(SameVoxels(sparse, pattern));
+  REQUIRE(sparse.NumStoredBricks() < size_t(5 * 2 * 3) / 2);
+  REQUIRE(sparse.ToBoolVoxelVolume().GetVoxels() == pattern.GetVoxels());
+}
+
+TEST_CASE("SparseBoolVoxelVolume boolean ops match BoolVoxelVolume") {
+  BoolVoxelVolume a = PatternVolume(32, 16, 24, 1);
+  BoolVoxelVolume b = PatternVolume(32, 16, 24, 2);
+  SparseBoolVoxelVolume sparse_a(a), sparse_b(b);
+
+  REQUIRE(SameVoxels(sparse_a.Union(sparse_b), a.Union(b)));
+  REQUIRE(SameVoxels(sparse_a.Intersect(sparse_b), a.Intersect(b)));
+  REQUIRE(SameVoxels(sparse_a.Subtract(sparse_b), a.Subtract(b)));
+  REQUIRE(sparse_a.Subtract(sparse_a).IsEmpty());
+  REQUIRE(sparse_a.Subtract(sparse_a).NumStoredBricks() == 0);
+
+  // full operands give full (flag) or copied bricks
+  SparseBoolVoxelVolume full(Eval(a | ~a));
+  REQUIRE(full.NumStoredBricks() == 0);
+  REQUIRE(sparse_a.Union(full).NumStoredBricks() == 0);
+  REQUIRE(SameVoxels(sparse_a.Intersect(full), a));
+  REQUIRE(SameVoxels(full.Subtract(sparse_a), Eval(~a)));
+  REQUIRE(sparse_a.Intersect(full).NumStoredBricks() ==
+    sparse_a.NumStoredBricks());
+  REQUIRE(sparse_a.Subtract(full).NumStoredBricks() == 0);
+  REQUIRE(sparse_a.Subtract(full).IsEmpty());
+  REQUIRE(SameVoxels(full.Union(sparse_a), Eval(a | ~a)));
+
+  // and empty ones give empty or copied bricks, in either order
+  SparseBoolVoxelVolume empty(32, 16, 24);
+  for(const SparseBoolVoxelVolume &copied: {sparse_a.Union(empty),
+      empty.Union(sparse_a), sparse_a.Subtract(empty)}) {
+    REQUIRE(SameVoxels(copied, a));
+    REQUIRE(copied.NumStoredBricks() == sparse_a.NumStoredBricks());
+  }
+  REQUIRE(sparse_a.Intersect(empty).NumStoredBricks() == 0);
+  REQUIRE(empty.Intersect(sparse_a).IsEmpty());
+  REQUIRE(empty.Subtract(sparse_a).IsEmpty());
+}
+
+TEST_CASE("SparseBoolVoxelVolume rotations match BoolVoxelVolume") {
+  BoolVoxelVolume v = PatternVolume(24, 24, 24, 3);
+  // make partly filled bricks asymmetric
+  v.Set(1, 2, 3);
+  v.Set(9, 4, 17);
+  SparseBoolVoxelVolume sparse(v);
+
+  REQUIRE(SameVoxels(sparse.RotateX(), v.RotateX()));
+  REQUIRE(SameVoxels(sparse.RotateY(), v.RotateY()));
+  REQUIRE(SameVoxels(sparse.RotateZ(), v.RotateZ()));
+  REQUIRE(SameVoxels(
+    sparse.RotateX().RotateY().RotateZ(), v.RotateX().RotateY().RotateZ()));
+
+  // RotateX only needs a square YZ cross-section
+  BoolVoxelVolume wide = PatternVolume(40, 16, 16, 4);
+  REQUIRE(SameVoxels(SparseBoolVoxelVolume(wide).RotateX(), wide.RotateX()));
+}
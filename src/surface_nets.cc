@@ -0,0 +1,367 @@
+#include "surface_nets.h"
+
+#include "bool_voxel_ops.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// which voxels of a row are inside, 1 bit each
+using RowBits = uint64_t;
+constexpr int BitsPerRowWord = 64;
+
+// a BasicBoolVoxelVolume as a field of -1 inside and 1 outside
+template<typename Word>
+class BoolField {
+public:
+  explicit BoolField(const BasicBoolVoxelVolume<Word> &volume) :
+    volume_(volume) {}
+
+  // the value of voxels beyond the volume
+  float Outside() const { return 1; }
+
+  // set bits of "bits", which start out 0, for the inside voxels of row y,z
+  void InsideBits(int y, int z, RowBits *bits) const {
+    constexpr int VoxelsPerWord = BasicBoolVoxelVolume<Word>::VoxelsPerWord;
+    const int x_words = volume_.XWords();
+    const Word *row = volume_.GetVoxels().data() +
+      (size_t(z) * volume_.YSize() + y) * x_words;
+    for(int i = 0; i < x_words; i++) {
+      const int bit = i * VoxelsPerWord;
+      bits[bit / BitsPerRowWord] |= RowBits(row[i]) << (bit % BitsPerRowWord);
+    }
+  }
+
+  float Value(int x, int y, int z) const {
+    return volume_.Get(x,y,z) ? -1 : 1;
+  }
+
+  // not a virtual call
+  Color ColorOf(int x, int y, int z) const {
+    return volume_.BasicBoolVoxelVolume<Word>::GetColor(x,y,z);
+  }
+
+private:
+  const BasicBoolVoxelVolume<Word> &volume_;
+};
+
+// a signed distance field, clamped to +-"limit"
+class DistanceField {
+public:
+  DistanceField(const FloatVoxelVolume &volume, float limit) :
+    volume_(volume), limit_(limit) {}
+
+  float Outside() const { return limit_; }
+
+  void InsideBits(int y, int z, RowBits *bits) const {
+    const int x_size = volume_.XSize();
+    const float *row = volume_.GetVoxels().data() +
+      (size_t(z) * volume_.YSize() + y) * x_size;
+    for(int x = 0; x < x_size; x++)
+      bits[x / BitsPerRowWord] |= RowBits(row[x] <= 0) << (x % BitsPerRowWord);
+  }
+
+  float Value(int x, int y, int z) const {
+    return std::clamp(volume_.Get(x,y,z), -limit_, limit_);
+  }
+
+  Color ColorOf(int x, int y, int z) const {
+    return volume_.FloatVoxelVolume::GetColor(x,y,z);
+  }
+
+private:
+  const FloatVoxelVolume &volume_;
+  float limit_;
+};
+
+/*
+Meshes slabs of cells of a Field. Cell cx,cy,cz has the voxels from
+cx-1,cy-1,cz-1 to cx,cy,cz at its corners, so there are cells from 0 to
+x_size inclusive, etc., and the cells at either end reach beyond the volume.
+Corner i of a cell is the voxel at (i & 1, (i >> 1) & 1, i >> 2) within it.
+*/
+template<typename Field>
+class SurfaceNetMesher {
+public:
+  SurfaceNetMesher(const VoxelVolume &volume, const Field &field) :
+    field_(field),
+    x_size_(volume.XSize()), y_size_(volume.YSize()), z_size_(volume.ZSize()),
+    cell_words_((x_size_ + 1 + BitsPerRowWord - 1) / BitsPerRowWord),
+    cells_x_size_(x_size_ + 1),
+    cell_slice_size_(size_t(x_size_ + 1) * (y_size_ + 1)),
+    min_(volume.MinBound()),
+    voxel_size_ {volume.VoxelXSize(), volume.VoxelYSize(), volume.VoxelZSize()},
+    inside_(2 * size_t(y_size_) * cell_words_),
+    zero_row_(cell_words_, 0),
+    mixed_(cell_words_),
+    cell_verts_(2 * cell_slice_size_)
+  {}
+
+  /*
+  The mesh of the cells from slice "cz_begin" to "cz_end" - 1, with vertex
+  indices counted from this slab's first vertex. Quads reaching down into
+  slice cz_begin - 1 use its vertices, which the slab below made last, in the
+  same order: negative indices, counting back from this slab's first vertex.
+  */
+  TriMesh MeshSlab(int cz_begin, int cz_end) {
+    TriMesh mesh;
+    mesh.has_color = true;
+
+    if(cz_begin > 0) {
+      LoadInsideSlice(cz_begin - 2);
+      LoadInsideSlice(cz_begin - 1);
+      int below = 0;
+      for(int cy = 0; cy <= y_size_; cy++) {
+        FindMixedCells(cy, cz_begin - 1);
+        for(RowBits bits: mixed_)
+          below += PopCount(bits);
+      }
+      int next = -below;
+      for(int cy = 0; cy <= y_size_; cy++) {
+        FindMixedCells(cy, cz_begin - 1);
+        ForEachMixedCell([&](int cx) {
+          CellVert(cx, cy, cz_begin - 1) = next++;
+        });
+      }
+    }
+
+    for(int cz = cz_begin; cz < cz_end; cz++) {
+      LoadInsideSlice(cz);
+      for(int cy = 0; cy <= y_size_; cy++) {
+        FindMixedCells(cy, cz);
+        ForEachMixedCell([&](int cx) { AddCell(cx, cy, cz, &mesh); });
+      }
+    }
+    return mesh;
+  }
+
+private:
+  // the inside bits of voxel row y,z, which is all 0 beyond the volume
+  const RowBits* InsideRow(int y, int z) const {
+    if(y < 0 || y >= y_size_ || z < 0 || z >= z_size_)
+      return zero_row_.data();
+    return inside_.data() + ((z & 1) * size_t(y_size_) + y) * cell_words_;
+  }
+
+  // Fill in the inside bits of slice z, in place of slice z - 2. Only 2
+  // slices, z - 1 and z, are needed at a time.
+  void LoadInsideSlice(int z) {
+    if(z < 0 || z >= z_size_)
+      return;
+    RowBits *slice = inside_.data() + (z & 1) * size_t(y_size_) * cell_words_;
+    std::fill_n(slice, size_t(y_size_) * cell_words_, 0);
+    for(int y = 0; y < y_size_; y++)
+      field_.InsideBits(y, z, slice + size_t(y) * cell_words_);
+  }
+
+  // Set mixed_ to which cells of row cy,cz have both inside and outside
+  // corners. Bit cx of a row's bits shifted up by 1 is voxel cx - 1, so the
+  // cells with any inside corners are the OR of the 4 rows of voxels at their
+  // corners, and both shifted, and those with all inside the AND.
+  void FindMixedCells(int cy, int cz) {
+    const RowBits *rows[4] = {
+      InsideRow(cy - 1, cz - 1), InsideRow(cy, cz - 1),
+      InsideRow(cy - 1, cz), InsideRow(cy, cz)
+    };
+    for(int i = 0; i < cell_words_; i++) {
+      RowBits any = 0, all = ~RowBits(0);
+      for(const RowBits *row: rows) {
+        const RowBits shifted = (row[i] << 1) |
+          (i > 0 ? row[i-1] >> (BitsPerRowWord - 1) : 0);
+        any |= row[i] | shifted;
+        all &= row[i] & shifted;
+      }
+      mixed_[i] = any & ~all;
+    }
+  }
+
+  template<typename Func>
+  void ForEachMixedCell(Func f) const {
+    for(int i = 0; i < cell_words_; i++) {
+      for(RowBits bits = mixed_[i]; bits; bits &= bits - 1)
+        f(i * BitsPerRowWord + LowestSetBit(bits));
+    }
+  }
+
+  // the vertex index of cell cx,cy in slice cz, which must be 1 of the last 2
+  int& CellVert(int cx, int cy, int cz) {
+    return cell_verts_[(cz & 1) * cell_slice_size_ +
+      size_t(cy) * cells_x_size_ + cx];
+  }
+
+  float Value(int x, int y, int z) const {
+    if(x < 0 || x >= x_size_ || y < 0 || y >= y_size_ || z < 0 ||
+       z >= z_size_)
+      return field_.Outside();
+    return field_.Value(x,y,z);
+  }
+
+  // add the vertex of mixed cell cx,cy,cz, and the quads of the edges from
+  // its corner 0
+  void AddCell(int cx, int cy, int cz, TriMesh *mesh) {
+    float f[8];
+    for(int i = 0; i < 8; i++) {
+      f[i] = Value(
+        cx - 1 + (i & 1), cy - 1 + ((i >> 1) & 1), cz - 1 + (i >> 2));
+    }
+
+    // the mean of the edge crossings, within the cell
+    static constexpr int edges[12][2] = {
+      {0, 1}, {2, 3}, {4, 5}, {6, 7}, {0, 2}, {1, 3},
+      {4, 6}, {5, 7}, {0, 4}, {1, 5}, {2, 6}, {3, 7}
+    };
+    Vector3f sum {0, 0, 0};
+    int crossings = 0;
+    for(const auto &edge: edges) {
+      const int a = edge[0], b = edge[1];
+      if((f[a] <= 0) == (f[b] <= 0))
+        continue;
+      const float t = f[a] / (f[a] - f[b]);
+      sum += Vector3f {
+        (a & 1) + t * ((b & 1) - (a & 1)),
+        ((a >> 1) & 1) + t * (((b >> 1) & 1) - ((a >> 1) & 1)),
+        (a >> 2) + t * ((b >> 2) - (a >> 2))
+      };
+      crossings++;
+    }
+    assert(crossings > 0);
+    const Vector3f within = sum / float(crossings);
+
+    // the voxel centers at the corners are at cx - 0.5 etc.
+    CellVert(cx, cy, cz) = int(mesh->verts.size());
+    mesh->verts.push_back(Vector3f {
+      min_.x + (cx - 0.5f + within.x) * voxel_size_.x,
+      min_.y + (cy - 0.5f + within.y) * voxel_size_.y,
+      min_.z + (cz - 0.5f + within.z) * voxel_size_.z
+    });
+
+    // the gradient, which points outward, from the differences across the
+    // cell along each axis
+    Vector3f gradient {0, 0, 0};
+    for(int i = 0; i < 8; i++) {
+      gradient.x += (i & 1 ? f[i] : -f[i]);
+      gradient.y += ((i >> 1) & 1 ? f[i] : -f[i]);
+      gradient.z += (i >> 2 ? f[i] : -f[i]);
+    }
+    gradient = Vector3f {gradient.x / voxel_size_.x,
+      gradient.y / voxel_size_.y, gradient.z / voxel_size_.z};
+    const float length = gradient.len();
+    mesh->normals.push_back(length > 0 ? gradient / length : gradient);
+
+    // The quad of the edge from corner 0 along each axis joins the 4 cells
+    // around that edge, this one and 3 made before it: A, B, C (this one),
+    // and D go counter-clockwise around the axis, so the quad faces along
+    // the axis when corner 0 is inside, and the other way when it's outside.
+    auto add_quad = [&](int corner, int a, int b, int d) {
+      const bool inside = f[0] <= 0;
+      if(inside == (f[corner] <= 0))
+        return;
+      const int c = CellVert(cx, cy, cz);
+      const int inside_corner = inside ? 0 : corner;
+      const Color color = field_.ColorOf(cx - 1 + (inside_corner & 1),
+        cy - 1 + ((inside_corner >> 1) & 1), cz - 1 + (inside_corner >> 2));
+      if(!inside)
+        std::swap(b, d);
+      mesh->tris.emplace_back(a, b, c, a, b, c, color);
+      mesh->tris.emplace_back(a, c, d, a, c, d, color);
+    };
+    // the crossed edges are between voxels in the volume, so the cells
+    // around them are too
+    if(cy > 0 && cz > 0) {
+      add_quad(1, CellVert(cx, cy - 1, cz - 1), CellVert(cx, cy, cz - 1),
+        CellVert(cx, cy - 1, cz));
+    }
+    if(cx > 0 && cz > 0) {
+      add_quad(2, CellVert(cx - 1, cy, cz - 1), CellVert(cx - 1, cy, cz),
+        CellVert(cx, cy, cz - 1));
+    }
+    if(cx > 0 && cy > 0) {
+      add_quad(4, CellVert(cx - 1, cy - 1, cz), CellVert(cx, cy - 1, cz),
+        CellVert(cx - 1, cy, cz));
+    }
+  }
+
+  const Field &field_;
+  const int x_size_, y_size_, z_size_;
+  const int cell_words_; // words in a row of cells' bits, and of voxels'
+  const int cells_x_size_;
+  const size_t cell_slice_size_;
+  const Vector3f min_, voxel_size_;
+
+  std::vector<RowBits> inside_; // 2 slices of rows of inside bits
+  const std::vector<RowBits> zero_row_;
+  std::vector<RowBits> mixed_; // a row of cells with the surface in them
+  std::vector<int> cell_verts_; // the vertex of each cell, in 2 slices
+};
+
+template<typename Field>
+TriMesh SurfaceNets(const VoxelVolume &volume, const Field &field, int slabs) {
+  // slices of cells, from 0 to z_size inclusive
+  const int cells_z_size = volume.ZSize() + 1;
+  slabs = std::max(1, std::min(slabs, cells_z_size));
+  std::vector<TriMesh> meshes(slabs);
+  ParallelFor(0, slabs, [&](int i) {
+    SurfaceNetMesher<Field> mesher(volume, field);
+    meshes[i] = mesher.MeshSlab(SplitRange(0, cells_z_size, slabs, i),
+      SplitRange(0, cells_z_size, slabs, i + 1));
+  });
+
+  // each slab's vertices follow those of the slabs below
+  std::vector<size_t> verts(slabs + 1, 0), tris(slabs + 1, 0);
+  for(int i = 0; i < slabs; i++) {
+    verts[i + 1] = verts[i] + meshes[i].verts.size();
+    tris[i + 1] = tris[i] + meshes[i].tris.size();
+  }
+  TriMesh mesh;
+  mesh.has_color = true;
+  mesh.verts.resize(verts[slabs]);
+  mesh.normals.resize(verts[slabs]);
+  // no default constructor to resize with
+  mesh.tris.assign(tris[slabs], Tri(0, 0, 0));
+  ParallelFor(0, slabs, [&](int i) {
+    TriMesh &slab = meshes[i];
+    std::copy(slab.verts.begin(), slab.verts.end(),
+      mesh.verts.begin() + verts[i]);
+    std::copy(slab.normals.begin(), slab.normals.end(),
+      mesh.normals.begin() + verts[i]);
+    Tri *out = mesh.tris.data() + tris[i];
+    for(const Tri &tri: slab.tris) {
+      *out = tri;
+      for(int j = 0; j < 3; j++) {
+        out->vert_idxs[j] += int(verts[i]);
+        out->normal_idxs[j] += int(verts[i]);
+      }
+      out++;
+    }
+    slab = TriMesh();
+  });
+  return mesh;
+}
+
+} // namespace
+
+template<typename Word>
+TriMesh CreateSurfaceNetMesh(
+  const BasicBoolVoxelVolume<Word> &volume, int slabs
+) {
+  return SurfaceNets(volume, BoolField<Word>(volume), slabs);
+}
+
+TriMesh CreateSurfaceNetMesh(const FloatVoxelVolume &field, int slabs) {
+  const float limit = std::max({std::abs(field.VoxelXSize()),
+    std::abs(field.VoxelYSize()), std::abs(field.VoxelZSize())});
+  return SurfaceNets(field, DistanceField(field, limit), slabs);
+}
+
+template TriMesh CreateSurfaceNetMesh(
+  const BasicBoolVoxelVolume<uint8_t>&, int);
+template TriMesh CreateSurfaceNetMesh(
+  const BasicBoolVoxelVolume<uint16_t>&, int);
+template TriMesh CreateSurfaceNetMesh(
+  const BasicBoolVoxelVolume<uint32_t>&, int);
+template TriMesh CreateSurfaceNetMesh(
+  const BasicBoolVoxelVolume<uint64_t>&, int);
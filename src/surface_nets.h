@@ -0,0 +1,38 @@
+#ifndef SURFACE_NETS_H
+#define SURFACE_NETS_H
+
+#include "bool_voxel_volume.h"
+#include "float_voxel_volume.h"
+#include "mesh.h"
+#include "parallel_for.h"
+
+/*
+A smooth mesh of a volume's surface, by surface nets.
+
+The surface passes between the centers of each inside voxel and each outside
+voxel next to it. Each cell of 8 neighboring voxel centers that the surface
+passes through gets a vertex, at the mean of the points where the surface
+crosses the cell's edges, and each edge it crosses gets a quad joining the
+vertices of the 4 cells around that edge. Voxels beyond the volume count as
+outside, so the mesh is closed, as CreateBlockMesh's is. Each vertex has its
+own normal, from the gradient of the field across its cell, and each quad the
+color (GetColor) of the inside voxel of its edge.
+
+For a BoolVoxelVolume the surface crosses every edge at its middle. A
+FloatVoxelVolume is taken to be a signed distance field, e.g. from
+SignedDistanceField, with the surface where the field crosses 0 between the
+voxel centers, and inside where GetBool is. Distances are clamped to a voxel
+either way, so infinite ones do no harm.
+
+The cells the surface passes through are found 64 at a time, from bits of
+which voxels are inside. The volume is meshed in "slabs" Z slabs in parallel,
+each keeping the vertex indices of only 2 slices of cells; the mesh is the
+same for any number of slabs.
+*/
+template<typename Word>
+TriMesh CreateSurfaceNetMesh(
+  const BasicBoolVoxelVolume<Word> &volume, int slabs = ParallelThreads());
+TriMesh CreateSurfaceNetMesh(
+  const FloatVoxelVolume &field, int slabs = ParallelThreads());
+
+#endif
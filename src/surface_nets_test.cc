@@ -0,0 +1,141 @@
+#include "surface_nets.h"
+
+#include "catch.h"
+#include "mesh_test_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+
+// the furthest any vertex of "mesh" is from the sphere of "radius" around
+// "center"
+float MaxSphereError(
+  const TriMesh &mesh, const Vector3f &center, float radius
+) {
+  float error = 0;
+  for(const Vector3f &vert: mesh.verts)
+    error = std::max(error, std::abs((vert - center).len() - radius));
+  return error;
+}
+
+// whether every vertex normal is a unit vector pointing away from "center"
+bool NormalsPointOut(const TriMesh &mesh, const Vector3f &center) {
+  for(size_t i = 0; i < mesh.verts.size(); i++) {
+    const Vector3f &normal = mesh.normals[i];
+    if(std::abs(normal.len() - 1) > 1e-4f)
+      return false;
+    if(dot(normal, mesh.verts[i] - center) <= 0)
+      return false;
+  }
+  return true;
+}
+
+} // namespace
+
+TEST_CASE("Surface nets of a ball") {
+  // a ball, off center, in voxels half as deep as they are wide
+  const int x_size = 70, y_size = 31, z_size = 29;
+  const Vector3f center {35, 15, 7};
+  const float radius = 13;
+  BoolVoxelVolume ball(x_size, y_size, z_size);
+  ball.SetBounds(Vector3f {0, 0, 0},
+    Vector3f {float(x_size), float(y_size), float(z_size) * 0.5f});
+  FloatVoxelVolume field(x_size, y_size, z_size);
+  field.SetBounds(ball.MinBound(), ball.MaxBound());
+  for(int z = 0; z < z_size; z++) {
+    for(int y = 0; y < y_size; y++) {
+      for(int x = 0; x < x_size; x++) {
+        Vector3f from_center = ball.CenterOf(x,y,z) - center;
+        // a sphere in voxels, so squashed along Z in the world
+        from_center.z *= 2;
+        const float distance = from_center.len() - radius;
+        field.Set(x, y, z, distance);
+        if(distance <= 0)
+          ball.Set(x,y,z);
+      }
+    }
+  }
+  // meshes stretched back into the sphere
+  const Vector3f stretched_center {center.x, center.y, center.z * 2};
+  auto stretch = [](TriMesh mesh) {
+    for(Vector3f &vert: mesh.verts)
+      vert.z *= 2;
+    return mesh;
+  };
+
+  SECTION("from a BoolVoxelVolume") {
+    TriMesh mesh = CreateSurfaceNetMesh(ball, 1);
+    REQUIRE(mesh.has_color);
+    REQUIRE(!mesh.tris.empty());
+    REQUIRE(mesh.normals.size() == mesh.verts.size());
+    REQUIRE(IsWatertight(mesh));
+    // a quad for each face of the block mesh
+    REQUIRE(mesh.tris.size() == ball.CreateBlockMesh().tris.size());
+
+    TriMesh stretched = stretch(mesh);
+    REQUIRE(MaxSphereError(stretched, stretched_center, radius) < 1);
+    REQUIRE(EnclosedVolume(stretched) ==
+      Approx(4 / 3.0 * M_PI * radius * radius * radius).epsilon(0.05));
+
+    for(int slabs: {2, 3, 7, 30, 100})
+      REQUIRE(SameMesh(CreateSurfaceNetMesh(ball, slabs), mesh));
+
+    // other word sizes
+    BasicBoolVoxelVolume<uint8_t> narrow(x_size, y_size, z_size);
+    narrow.SetBounds(ball.MinBound(), ball.MaxBound());
+    for(int z = 0; z < z_size; z++) {
+      for(int y = 0; y < y_size; y++) {
+        for(int x = 0; x < x_size; x++) {
+          if(ball.Get(x,y,z))
+            narrow.Set(x,y,z);
+        }
+      }
+    }
+    REQUIRE(SameMesh(CreateSurfaceNetMesh(narrow, 3), mesh));
+  }
+
+  SECTION("from a signed distance field") {
+    TriMesh mesh = CreateSurfaceNetMesh(field, 1);
+    REQUIRE(IsWatertight(mesh));
+    REQUIRE(mesh.tris.size() == ball.CreateBlockMesh().tris.size());
+
+    // much closer to the sphere than the blocky one
+    TriMesh stretched = stretch(mesh);
+    REQUIRE(MaxSphereError(stretched, stretched_center, radius) < 0.2f);
+    REQUIRE(EnclosedVolume(stretched) ==
+      Approx(4 / 3.0 * M_PI * radius * radius * radius).epsilon(0.01));
+    REQUIRE(NormalsPointOut(mesh, center));
+
+    for(int slabs: {2, 3, 7, 30, 100})
+      REQUIRE(SameMesh(CreateSurfaceNetMesh(field, slabs), mesh));
+  }
+}
+
+TEST_CASE("Surface nets of speckles and edges") {
+  // random speckles, touching along edges and corners, and filling the
+  // volume's faces so the mesh is closed by the cells beyond them
+  std::mt19937 rng(5);
+  for(int size: {1, 2, 63, 64, 65}) {
+    BoolVoxelVolume v(size, 5, 6);
+    for(int z = 0; z < 6; z++) {
+      for(int y = 0; y < 5; y++) {
+        for(int x = 0; x < size; x++) {
+          if(rng() % 3 == 0 || y == 0 || x == size - 1)
+            v.Set(x,y,z);
+        }
+      }
+    }
+    TriMesh mesh = CreateSurfaceNetMesh(v, 1);
+    REQUIRE(IsWatertight(mesh));
+    REQUIRE(mesh.tris.size() == v.CreateBlockMesh().tris.size());
+    for(int slabs: {2, 4, 7})
+      REQUIRE(SameMesh(CreateSurfaceNetMesh(v, slabs), mesh));
+  }
+
+  // nothing to mesh
+  BoolVoxelVolume empty(10, 3, 3);
+  REQUIRE(CreateSurfaceNetMesh(empty).tris.empty());
+  REQUIRE(CreateSurfaceNetMesh(empty).verts.empty());
+}
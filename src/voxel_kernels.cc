@@ -0,0 +1,324 @@
+#include "voxel_kernels.h"
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VOXEL_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+enum class BinaryOp { Or, And, AndNot };
+
+template<BinaryOp Op, typename T>
+inline T Apply(T a, T b) {
+  switch(Op) {
+  case BinaryOp::Or:     return a | b;
+  case BinaryOp::And:    return a & b;
+  case BinaryOp::AndNot: return a & ~b;
+  }
+  return 0;
+}
+
+// Scalar ////////////////////////////////////////////////////////////////////
+
+// Process 8 bytes at a time, then finish byte by byte. The vector kernels use
+// this for whatever's left over after their last full vector.
+template<BinaryOp Op>
+void ScalarBinary(const void *a, const void *b, void *c, size_t bytes) {
+  const uint8_t *a_bytes = static_cast<const uint8_t*>(a);
+  const uint8_t *b_bytes = static_cast<const uint8_t*>(b);
+  uint8_t *c_bytes = static_cast<uint8_t*>(c);
+
+  size_t i = 0;
+  for(; i + sizeof(uint64_t) <= bytes; i += sizeof(uint64_t)) {
+    uint64_t a_word, b_word;
+    memcpy(&a_word, a_bytes + i, sizeof(uint64_t));
+    memcpy(&b_word, b_bytes + i, sizeof(uint64_t));
+    uint64_t c_word = Apply<Op>(a_word, b_word);
+    memcpy(c_bytes + i, &c_word, sizeof(uint64_t));
+  }
+  for(; i < bytes; i++)
+    c_bytes[i] = Apply<Op>(a_bytes[i], b_bytes[i]);
+}
+
+bool ScalarAnySet(const void *a, size_t bytes) {
+  const uint8_t *a_bytes = static_cast<const uint8_t*>(a);
+
+  size_t i = 0;
+  for(; i + sizeof(uint64_t) <= bytes; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, a_bytes + i, sizeof(uint64_t));
+    if(word)
+      return true;
+  }
+  for(; i < bytes; i++) {
+    if(a_bytes[i])
+      return true;
+  }
+  return false;
+}
+
+void ScalarSweepRows(
+  const void *source, const void *fill_row, void *dest,
+  size_t row_bytes, size_t rows
+) {
+  const uint8_t *source_row = static_cast<const uint8_t*>(source);
+  uint8_t *dest_row = static_cast<uint8_t*>(dest);
+  for(size_t i = 0; i < rows; i++) {
+    if(ScalarAnySet(source_row, row_bytes))
+      memcpy(dest_row, fill_row, row_bytes);
+    source_row += row_bytes;
+    dest_row += row_bytes;
+  }
+}
+
+const VoxelKernels ScalarKernels = {
+  "scalar",
+  ScalarBinary<BinaryOp::Or>,
+  ScalarBinary<BinaryOp::And>,
+  ScalarBinary<BinaryOp::AndNot>,
+  ScalarAnySet,
+  ScalarSweepRows,
+};
+
+#ifdef VOXEL_KERNELS_X86
+
+// SSE2 //////////////////////////////////////////////////////////////////////
+
+template<BinaryOp Op>
+__attribute__((target("sse2")))
+void Sse2Binary(const void *a, const void *b, void *c, size_t bytes) {
+  const uint8_t *a_bytes = static_cast<const uint8_t*>(a);
+  const uint8_t *b_bytes = static_cast<const uint8_t*>(b);
+  uint8_t *c_bytes = static_cast<uint8_t*>(c);
+
+  constexpr size_t vec_bytes = sizeof(__m128i);
+  size_t i = 0;
+  for(; i + vec_bytes <= bytes; i += vec_bytes) {
+    __m128i a_vec =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(a_bytes + i));
+    __m128i b_vec =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(b_bytes + i));
+    __m128i c_vec;
+    switch(Op) {
+    case BinaryOp::Or:     c_vec = _mm_or_si128(a_vec, b_vec); break;
+    case BinaryOp::And:    c_vec = _mm_and_si128(a_vec, b_vec); break;
+    case BinaryOp::AndNot: c_vec = _mm_andnot_si128(b_vec, a_vec); break;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(c_bytes + i), c_vec);
+  }
+  ScalarBinary<Op>(a_bytes + i, b_bytes + i, c_bytes + i, bytes - i);
+}
+
+__attribute__((target("sse2")))
+bool Sse2AnySet(const void *a, size_t bytes) {
+  const uint8_t *a_bytes = static_cast<const uint8_t*>(a);
+
+  constexpr size_t vec_bytes = sizeof(__m128i);
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for(; i + vec_bytes <= bytes; i += vec_bytes) {
+    __m128i vec =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(a_bytes + i));
+    if(_mm_movemask_epi8(_mm_cmpeq_epi8(vec, zero)) != 0xffff)
+      return true;
+  }
+  return ScalarAnySet(a_bytes + i, bytes - i);
+}
+
+__attribute__((target("sse2")))
+void Sse2SweepRows(
+  const void *source, const void *fill_row, void *dest,
+  size_t row_bytes, size_t rows
+) {
+  const uint8_t *source_row = static_cast<const uint8_t*>(source);
+  uint8_t *dest_row = static_cast<uint8_t*>(dest);
+  for(size_t i = 0; i < rows; i++) {
+    if(Sse2AnySet(source_row, row_bytes))
+      memcpy(dest_row, fill_row, row_bytes);
+    source_row += row_bytes;
+    dest_row += row_bytes;
+  }
+}
+
+const VoxelKernels Sse2Kernels = {
+  "sse2",
+  Sse2Binary<BinaryOp::Or>,
+  Sse2Binary<BinaryOp::And>,
+  Sse2Binary<BinaryOp::AndNot>,
+  Sse2AnySet,
+  Sse2SweepRows,
+};
+
+// AVX2 //////////////////////////////////////////////////////////////////////
+
+template<BinaryOp Op>
+__attribute__((target("avx2")))
+void Avx2Binary(const void *a, const void *b, void *c, size_t bytes) {
+  const uint8_t *a_bytes = static_cast<const uint8_t*>(a);
+  const uint8_t *b_bytes = static_cast<const uint8_t*>(b);
+  uint8_t *c_bytes = static_cast<uint8_t*>(c);
+
+  constexpr size_t vec_bytes = sizeof(__m256i);
+  size_t i = 0;
+  for(; i + vec_bytes <= bytes; i += vec_bytes) {
+    __m256i a_vec =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_bytes + i));
+    __m256i b_vec =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b_bytes + i));
+    __m256i c_vec;
+    switch(Op) {
+    case BinaryOp::Or:     c_vec = _mm256_or_si256(a_vec, b_vec); break;
+    case BinaryOp::And:    c_vec = _mm256_and_si256(a_vec, b_vec); break;
+    case BinaryOp::AndNot: c_vec = _mm256_andnot_si256(b_vec, a_vec); break;
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(c_bytes + i), c_vec);
+  }
+  ScalarBinary<Op>(a_bytes + i, b_bytes + i, c_bytes + i, bytes - i);
+}
+
+__attribute__((target("avx2")))
+bool Avx2AnySet(const void *a, size_t bytes) {
+  const uint8_t *a_bytes = static_cast<const uint8_t*>(a);
+
+  constexpr size_t vec_bytes = sizeof(__m256i);
+  size_t i = 0;
+  for(; i + vec_bytes <= bytes; i += vec_bytes) {
+    __m256i vec =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_bytes + i));
+    if(!_mm256_testz_si256(vec, vec))
+      return true;
+  }
+  return ScalarAnySet(a_bytes + i, bytes - i);
+}
+
+__attribute__((target("avx2")))
+void Avx2SweepRows(
+  const void *source, const void *fill_row, void *dest,
+  size_t row_bytes, size_t rows
+) {
+  const uint8_t *source_row = static_cast<const uint8_t*>(source);
+  uint8_t *dest_row = static_cast<uint8_t*>(dest);
+  for(size_t i = 0; i < rows; i++) {
+    if(Avx2AnySet(source_row, row_bytes))
+      memcpy(dest_row, fill_row, row_bytes);
+    source_row += row_bytes;
+    dest_row += row_bytes;
+  }
+}
+
+const VoxelKernels Avx2Kernels = {
+  "avx2",
+  Avx2Binary<BinaryOp::Or>,
+  Avx2Binary<BinaryOp::And>,
+  Avx2Binary<BinaryOp::AndNot>,
+  Avx2AnySet,
+  Avx2SweepRows,
+};
+
+// AVX-512 ///////////////////////////////////////////////////////////////////
+
+template<BinaryOp Op>
+__attribute__((target("avx512f")))
+void Avx512Binary(const void *a, const void *b, void *c, size_t bytes) {
+  const uint8_t *a_bytes = static_cast<const uint8_t*>(a);
+  const uint8_t *b_bytes = static_cast<const uint8_t*>(b);
+  uint8_t *c_bytes = static_cast<uint8_t*>(c);
+
+  constexpr size_t vec_bytes = sizeof(__m512i);
+  size_t i = 0;
+  for(; i + vec_bytes <= bytes; i += vec_bytes) {
+    __m512i a_vec = _mm512_loadu_si512(a_bytes + i);
+    __m512i b_vec = _mm512_loadu_si512(b_bytes + i);
+    __m512i c_vec;
+    switch(Op) {
+    case BinaryOp::Or:     c_vec = _mm512_or_si512(a_vec, b_vec); break;
+    case BinaryOp::And:    c_vec = _mm512_and_si512(a_vec, b_vec); break;
+    case BinaryOp::AndNot:
+      // truth table 0x30 = a & ~b. (_mm512_andnot_si512 trips a spurious
+      // -Wmaybe-uninitialized in GCC 12's headers.)
+      c_vec = _mm512_ternarylogic_epi64(a_vec, b_vec, b_vec, 0x30);
+      break;
+    }
+    _mm512_storeu_si512(c_bytes + i, c_vec);
+  }
+  ScalarBinary<Op>(a_bytes + i, b_bytes + i, c_bytes + i, bytes - i);
+}
+
+__attribute__((target("avx512f")))
+bool Avx512AnySet(const void *a, size_t bytes) {
+  const uint8_t *a_bytes = static_cast<const uint8_t*>(a);
+
+  constexpr size_t vec_bytes = sizeof(__m512i);
+  size_t i = 0;
+  for(; i + vec_bytes <= bytes; i += vec_bytes) {
+    __m512i vec = _mm512_loadu_si512(a_bytes + i);
+    if(_mm512_test_epi64_mask(vec, vec))
+      return true;
+  }
+  return ScalarAnySet(a_bytes + i, bytes - i);
+}
+
+__attribute__((target("avx512f")))
+void Avx512SweepRows(
+  const void *source, const void *fill_row, void *dest,
+  size_t row_bytes, size_t rows
+) {
+  const uint8_t *source_row = static_cast<const uint8_t*>(source);
+  uint8_t *dest_row = static_cast<uint8_t*>(dest);
+  for(size_t i = 0; i < rows; i++) {
+    if(Avx512AnySet(source_row, row_bytes))
+      memcpy(dest_row, fill_row, row_bytes);
+    source_row += row_bytes;
+    dest_row += row_bytes;
+  }
+}
+
+const VoxelKernels Avx512Kernels = {
+  "avx512",
+  Avx512Binary<BinaryOp::Or>,
+  Avx512Binary<BinaryOp::And>,
+  Avx512Binary<BinaryOp::AndNot>,
+  Avx512AnySet,
+  Avx512SweepRows,
+};
+
+#endif // VOXEL_KERNELS_X86
+
+} // namespace
+
+const VoxelKernels* GetVoxelKernels(VoxelKernelLevel level) {
+  switch(level) {
+  case VoxelKernelLevel::Scalar:
+    return &ScalarKernels;
+#ifdef VOXEL_KERNELS_X86
+  case VoxelKernelLevel::Sse2:
+    return __builtin_cpu_supports("sse2") ? &Sse2Kernels : nullptr;
+  case VoxelKernelLevel::Avx2:
+    return __builtin_cpu_supports("avx2") ? &Avx2Kernels : nullptr;
+  case VoxelKernelLevel::Avx512:
+    return __builtin_cpu_supports("avx512f") ? &Avx512Kernels : nullptr;
+#endif
+  default:
+    return nullptr;
+  }
+}
+
+const VoxelKernels& GetVoxelKernels() {
+  static const VoxelKernels &best = []() -> const VoxelKernels& {
+    for(VoxelKernelLevel level: {
+      VoxelKernelLevel::Avx512,
+      VoxelKernelLevel::Avx2,
+      VoxelKernelLevel::Sse2
+    }) {
+      if(const VoxelKernels *kernels = GetVoxelKernels(level))
+        return *kernels;
+    }
+    return ScalarKernels;
+  }();
+  return best;
+}
@@ -0,0 +1,50 @@
+#ifndef VOXEL_KERNELS_H
+#define VOXEL_KERNELS_H
+
+#include <cstddef>
+
+/*
+Bulk operations on arrays of packed bits, as used by BoolVoxelVolume.
+
+Each set of kernels targets one instruction set. GetVoxelKernels() picks the
+best set the CPU supports when first called. The arrays are measured in bytes
+and needn't be aligned, so the kernels don't care about the VoxelWord type.
+
+The kernels work on a whole array at a time, rather than one vector at a time,
+so each call costs one indirect branch, no matter how many voxels it covers.
+*/
+class VoxelKernels {
+public:
+  const char *name;
+
+  // c = a | b, c = a & b, c = a & ~b
+  void (*Or)(const void *a, const void *b, void *c, size_t bytes);
+  void (*And)(const void *a, const void *b, void *c, size_t bytes);
+  void (*AndNot)(const void *a, const void *b, void *c, size_t bytes);
+
+  // whether any bit is set; stops at the first non-zero vector
+  bool (*AnySet)(const void *a, size_t bytes);
+
+  // "source" and "dest" are "rows" rows of "row_bytes" bytes each. For every
+  // row of "source" with any bit set, copy "fill_row" into that row of "dest".
+  // Other rows of "dest" are left alone.
+  void (*SweepRows)(
+    const void *source, const void *fill_row, void *dest,
+    size_t row_bytes, size_t rows);
+};
+
+enum class VoxelKernelLevel {
+  Scalar,
+  Sse2,
+  Avx2,
+  Avx512,
+};
+
+// the kernels for the best level supported by this CPU
+const VoxelKernels& GetVoxelKernels();
+
+// the kernels for a specific level, or nullptr if this CPU (or compiler)
+// doesn't support it. Scalar is always supported.
+const VoxelKernels* GetVoxelKernels(VoxelKernelLevel level);
+
+#endif
@@ -0,0 +1,118 @@
+#include "voxel_kernels.h"
+
+#include "catch.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+std::vector<uint8_t> RandomBytes(size_t size, std::mt19937 *rng) {
+  std::vector<uint8_t> bytes(size);
+  for(uint8_t &byte: bytes)
+    byte = uint8_t((*rng)());
+  return bytes;
+}
+
+// every level this CPU supports, other than Scalar
+std::vector<const VoxelKernels*> VectorKernels() {
+  std::vector<const VoxelKernels*> kernels;
+  for(VoxelKernelLevel level: {
+    VoxelKernelLevel::Sse2,
+    VoxelKernelLevel::Avx2,
+    VoxelKernelLevel::Avx512
+  }) {
+    if(const VoxelKernels *k = GetVoxelKernels(level))
+      kernels.push_back(k);
+  }
+  return kernels;
+}
+
+} // namespace
+
+TEST_CASE("VoxelKernels match the scalar kernels") {
+  const VoxelKernels &scalar = *GetVoxelKernels(VoxelKernelLevel::Scalar);
+  std::mt19937 rng(0);
+
+  for(const VoxelKernels *kernels: VectorKernels()) {
+    INFO("kernels: " << kernels->name);
+
+    // sizes that do and don't fill whole vectors; offsets that misalign
+    for(size_t size: {0, 1, 7, 16, 31, 64, 100, 256, 1000}) {
+      for(size_t offset: {0, 1, 3}) {
+        INFO("size: " << size << " offset: " << offset);
+        std::vector<uint8_t> a = RandomBytes(size + offset, &rng);
+        std::vector<uint8_t> b = RandomBytes(size + offset, &rng);
+
+        using BinaryKernel = void (*)(const void*, const void*, void*, size_t);
+        for(auto [vector_op, scalar_op]: {
+          std::pair<BinaryKernel, BinaryKernel>(kernels->Or, scalar.Or),
+          std::pair<BinaryKernel, BinaryKernel>(kernels->And, scalar.And),
+          std::pair<BinaryKernel, BinaryKernel>(kernels->AndNot, scalar.AndNot)
+        }) {
+          std::vector<uint8_t> expected(size + offset), actual(size + offset);
+          scalar_op(a.data() + offset, b.data() + offset,
+            expected.data() + offset, size);
+          vector_op(a.data() + offset, b.data() + offset,
+            actual.data() + offset, size);
+          REQUIRE(actual == expected);
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("VoxelKernels AnySet") {
+  std::vector<const VoxelKernels*> all = VectorKernels();
+  all.push_back(GetVoxelKernels(VoxelKernelLevel::Scalar));
+
+  for(const VoxelKernels *kernels: all) {
+    INFO("kernels: " << kernels->name);
+    const size_t size = 200;
+    std::vector<uint8_t> bytes(size);
+    REQUIRE(!kernels->AnySet(bytes.data(), size));
+
+    // a single bit anywhere must be found
+    for(size_t i = 0; i < size; i++) {
+      for(int bit = 0; bit < 8; bit += 7) {
+        bytes[i] = uint8_t(1 << bit);
+        REQUIRE(kernels->AnySet(bytes.data(), size));
+        REQUIRE(!kernels->AnySet(bytes.data(), i));
+        bytes[i] = 0;
+      }
+    }
+  }
+}
+
+TEST_CASE("VoxelKernels SweepRows") {
+  const VoxelKernels &scalar = *GetVoxelKernels(VoxelKernelLevel::Scalar);
+  std::mt19937 rng(1);
+
+  for(const VoxelKernels *kernels: VectorKernels()) {
+    INFO("kernels: " << kernels->name);
+    for(size_t row_bytes: {4, 32, 100}) {
+      const size_t rows = 50;
+      std::vector<uint8_t> source = RandomBytes(row_bytes * rows, &rng);
+      // clear some rows entirely, and leave a single bit in others
+      for(size_t row = 0; row < rows; row += 3)
+        std::fill_n(&source[row * row_bytes], row_bytes, 0);
+      for(size_t row = 1; row < rows; row += 3) {
+        std::fill_n(&source[row * row_bytes], row_bytes, 0);
+        source[row * row_bytes + row % row_bytes] = 0x80;
+      }
+      std::vector<uint8_t> fill_row = RandomBytes(row_bytes, &rng);
+
+      std::vector<uint8_t> expected(row_bytes * rows);
+      std::vector<uint8_t> actual(row_bytes * rows);
+      scalar.SweepRows(
+        source.data(), fill_row.data(), expected.data(), row_bytes, rows);
+      kernels->SweepRows(
+        source.data(), fill_row.data(), actual.data(), row_bytes, rows);
+      REQUIRE(actual == expected);
+    }
+  }
+}
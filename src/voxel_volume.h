@@ -4,6 +4,24 @@
 #include "color.h"
 #include "mesh.h"
 
+enum class Axis { X, Y, Z };
+
+// which voxels count as a voxel's neighbors: the 6 that share a face with it,
+// or the 26 that share a face, edge, or corner
+enum class Neighborhood { Six, TwentySix };
+
+// the faces of a voxel, as bits of a mask, in the order CreateBlockMesh makes
+// them for each voxel
+enum BlockFace {
+  XNegFace = 1 << 0, XPosFace = 1 << 1,
+  YNegFace = 1 << 2, YPosFace = 1 << 3,
+  ZNegFace = 1 << 4, ZPosFace = 1 << 5
+};
+
+// how CreateBlockMesh makes each exposed face: as 2 triangles of its own, or
+// merged with its coplanar neighbors of the same color into rectangles
+enum class BlockMeshStyle { Faces, Greedy };
+
 /*
 A base class for a rectangular volume of voxels.
 
@@ -65,6 +83,14 @@ public:
   float VoxelYSize() const { return (y_max_ - y_min_) / y_size_; }
   float VoxelZSize() const { return (z_max_ - z_min_) / z_size_; }
 
+  // the positions of vertex 0,0,0 and vertex x_size_,y_size_,z_size_
+  Vector3f MinBound() const { return Vector3f {x_min_, y_min_, z_min_}; }
+  Vector3f MaxBound() const { return Vector3f {x_max_, y_max_, z_max_}; }
+  virtual void SetBounds(const Vector3f &min, const Vector3f &max) {
+    x_min_ = min.x; y_min_ = min.y; z_min_ = min.z;
+    x_max_ = max.x; y_max_ = max.y; z_max_ = max.z;
+  }
+
   // get the position of the center of the voxel at the given x,y,z address
   Vector3f CenterOf(int x, int y, int z) const;
 
@@ -75,8 +101,13 @@ public:
 
   // Create a mesh according to GetBool and GetColor. Every voxel for which
   // GetBool returns true will be a solid block of color GetColor. Everywhere
-  // that GetBool returns false will be empty space.
-  TriMesh CreateBlockMesh();
+  // that GetBool returns false will be empty space. Greedy meshes have far
+  // fewer triangles; see GreedyBlockMeshBuilder. Slabs of the volume are
+  // meshed in parallel, so GetBool and GetColor may be called from several
+  // threads at once. Subclasses that can find exposed faces faster than by
+  // calling GetBool for every neighbor override this, making the same mesh.
+  virtual TriMesh CreateBlockMesh(
+    BlockMeshStyle style = BlockMeshStyle::Faces);
 
 protected:
   // given the x,y,z address of a voxel, return its index in a linear, z-major
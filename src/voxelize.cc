@@ -0,0 +1,185 @@
+#include "voxelize.h"
+
+#include "bool_voxel_ops.h"
+#include "ohno.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// A triangle projected onto the YZ plane, wound counter-clockwise there, with
+// the X of each vertex kept to find where rays cross it.
+struct ProjectedTri {
+  double x[3], y[3], z[3];
+  // the range of rows whose centers its Y and Z extents cover
+  int y_begin, y_end, z_begin, z_end;
+};
+
+// where the ray along X through row "y" crosses the surface
+struct Crossing {
+  int y;
+  double x;
+
+  bool operator<(const Crossing &other) const {
+    return y != other.y ? y < other.y : x < other.x;
+  }
+};
+
+// > 0 if (py, pz) is to the left of the edge from vertex "a" to vertex "b"
+double EdgeFunction(
+  const ProjectedTri &tri, int a, int b, double py, double pz
+) {
+  return (tri.y[b] - tri.y[a]) * (pz - tri.z[a]) -
+    (tri.z[b] - tri.z[a]) * (py - tri.y[a]);
+}
+
+// Whether points exactly on the edge from "a" to "b" count as inside. Each
+// point on an edge shared by two triangles tiling the plane is inside exactly
+// one of them, because they traverse the edge in opposite directions.
+bool IsTopLeftEdge(const ProjectedTri &tri, int a, int b) {
+  const double dy = tri.y[b] - tri.y[a], dz = tri.z[b] - tri.z[a];
+  return dz < 0 || (dz == 0 && dy > 0);
+}
+
+bool InsideEdge(const ProjectedTri &tri, int a, int b, double e) {
+  return e > 0 || (e == 0 && IsTopLeftEdge(tri, a, b));
+}
+
+// the range of rows, with centers at min + (i + 0.5) * size, whose centers are
+// in [low, high], clamped to [0, n)
+void CenterRange(
+  double low, double high, double min, double size, int n,
+  int *begin, int *end
+) {
+  *begin = std::max(0, int(std::ceil((low - min) / size - 0.5)));
+  *end = std::min(n, int(std::floor((high - min) / size - 0.5)) + 1);
+}
+
+} // namespace
+
+BoolVoxelVolume Voxelize(const TriMesh &mesh, int resolution) {
+  if(mesh.tris.empty())
+    throw OHNO("can't voxelize a mesh with no triangles");
+  if(resolution < 1)
+    throw OHNO("voxelize resolution must be at least 1");
+
+  Vector3f min = mesh.verts[mesh.tris[0].vert_idxs[0]], max = min;
+  for(const Tri &tri: mesh.tris) {
+    for(int idx: tri.vert_idxs) {
+      const Vector3f &v = mesh.verts[idx];
+      min = Vector3f {std::min(min.x, v.x), std::min(min.y, v.y),
+        std::min(min.z, v.z)};
+      max = Vector3f {std::max(max.x, v.x), std::max(max.y, v.y),
+        std::max(max.z, v.z)};
+    }
+  }
+  const float longest = std::max({max.x - min.x, max.y - min.y, max.z - min.z});
+  if(!(longest > 0))
+    throw OHNO("can't voxelize a mesh with no extent");
+
+  const double size = double(longest) / resolution;
+  auto voxels_across = [&](float extent) {
+    // round off float error, so e.g. a cube doesn't get a sliver of a row
+    return std::max(1, int(std::ceil(extent / size - 1e-4)));
+  };
+  const int x_size = voxels_across(max.x - min.x);
+  const int y_size = voxels_across(max.y - min.y);
+  const int z_size = voxels_across(max.z - min.z);
+
+  BoolVoxelVolume volume(x_size, y_size, z_size);
+  volume.SetBounds(min, Vector3f {float(min.x + x_size * size),
+    float(min.y + y_size * size), float(min.z + z_size * size)});
+
+  // Project each triangle, and bucket it by the Z rows it might cross, as
+  // offsets into one array: bucket z is [bucket_starts[z], bucket_starts[z+1]).
+  // Triangles edge-on to X never cross a ray along X, so they're dropped.
+  std::vector<ProjectedTri> projected;
+  projected.reserve(mesh.tris.size());
+  std::vector<int> bucket_starts(z_size + 1, 0);
+  for(const Tri &tri: mesh.tris) {
+    ProjectedTri p;
+    for(int i = 0; i < 3; i++) {
+      const Vector3f &v = mesh.verts[tri.vert_idxs[i]];
+      p.x[i] = v.x; p.y[i] = v.y; p.z[i] = v.z;
+    }
+    const double area = EdgeFunction(p, 0, 1, p.y[2], p.z[2]);
+    if(area == 0)
+      continue;
+    if(area < 0) {
+      std::swap(p.x[1], p.x[2]);
+      std::swap(p.y[1], p.y[2]);
+      std::swap(p.z[1], p.z[2]);
+    }
+    CenterRange(std::min({p.y[0], p.y[1], p.y[2]}),
+      std::max({p.y[0], p.y[1], p.y[2]}), min.y, size, y_size,
+      &p.y_begin, &p.y_end);
+    CenterRange(std::min({p.z[0], p.z[1], p.z[2]}),
+      std::max({p.z[0], p.z[1], p.z[2]}), min.z, size, z_size,
+      &p.z_begin, &p.z_end);
+    if(p.y_begin >= p.y_end || p.z_begin >= p.z_end)
+      continue;
+    for(int z = p.z_begin; z < p.z_end; z++)
+      bucket_starts[z + 1]++;
+    projected.push_back(p);
+  }
+  for(int z = 0; z < z_size; z++)
+    bucket_starts[z + 1] += bucket_starts[z];
+  std::vector<int> buckets(bucket_starts[z_size]);
+  {
+    std::vector<int> next(bucket_starts.begin(), bucket_starts.end() - 1);
+    for(int i = 0; i < int(projected.size()); i++) {
+      for(int z = projected[i].z_begin; z < projected[i].z_end; z++)
+        buckets[next[z]++] = i;
+    }
+  }
+
+  using VoxelWord = BoolVoxelVolume::VoxelWord;
+  VoxelWord *voxels = volume.MutableVoxels();
+  const int x_words = volume.XWords();
+
+  // each slab writes only its own rows
+  ParallelFor(0, z_size, [&](int z) {
+    const double pz = min.z + (z + 0.5) * size;
+    std::vector<Crossing> crossings;
+    for(int b = bucket_starts[z]; b < bucket_starts[z + 1]; b++) {
+      const ProjectedTri &tri = projected[buckets[b]];
+      for(int y = tri.y_begin; y < tri.y_end; y++) {
+        const double py = min.y + (y + 0.5) * size;
+        const double w0 = EdgeFunction(tri, 1, 2, py, pz);
+        const double w1 = EdgeFunction(tri, 2, 0, py, pz);
+        const double w2 = EdgeFunction(tri, 0, 1, py, pz);
+        if(InsideEdge(tri, 1, 2, w0) && InsideEdge(tri, 2, 0, w1) &&
+           InsideEdge(tri, 0, 1, w2)) {
+          const double x =
+            (w0 * tri.x[0] + w1 * tri.x[1] + w2 * tri.x[2]) / (w0 + w1 + w2);
+          crossings.push_back(Crossing {y, x});
+        }
+      }
+    }
+    std::sort(crossings.begin(), crossings.end());
+
+    auto first_center_at = [&](double x) {
+      return std::min(x_size,
+        std::max(0, int(std::ceil((x - min.x) / size - 0.5))));
+    };
+
+    // fill between each pair of crossings; an unpaired crossing, from a hole
+    // in the mesh, is dropped
+    for(size_t i = 0; i + 1 < crossings.size(); ) {
+      const Crossing &enter = crossings[i], &exit = crossings[i + 1];
+      if(enter.y != exit.y) {
+        i++;
+        continue;
+      }
+      // voxels with centers in [enter.x, exit.x)
+      SetBitRange(voxels + (size_t(z) * y_size + enter.y) * x_words,
+        first_center_at(enter.x), first_center_at(exit.x));
+      i += 2;
+    }
+  });
+
+  return volume;
+}
@@ -0,0 +1,27 @@
+#ifndef VOXELIZE_H
+#define VOXELIZE_H
+
+#include "bool_voxel_volume.h"
+#include "mesh.h"
+
+/*
+Convert a closed TriMesh to voxels: a voxel is set if its center is inside
+the mesh.
+
+The voxels are cubes, "resolution" of them along the longest side of the mesh's
+bounding box, and as many as it takes to cover the other sides. The volume's
+bounds start at the minimum corner of the mesh's bounding box.
+
+This is scanline parity along X. For each row of voxels, a ray along X
+through the voxel centers crosses the mesh's surface an even number of times,
+and the voxels between the 1st and 2nd crossing, the 3rd and 4th, etc. are
+inside. Each such segment is written as whole-word masks. Triangles are
+bucketed by the Z slabs they span, then the slabs are voxelized in parallel.
+
+Rays that pass exactly through an edge or vertex shared by several triangles
+count it once, by the top-left fill rule, so watertight meshes voxelize without
+streaks. A mesh with holes can still give streaks along rows through a hole.
+*/
+BoolVoxelVolume Voxelize(const TriMesh &mesh, int resolution);
+
+#endif
@@ -0,0 +1,105 @@
+#include "voxelize.h"
+
+#include "catch.h"
+
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+// add an axis-aligned box from "min" to "max", two triangles per face
+void AddBox(TriMesh *mesh, const Vector3f &min, const Vector3f &max) {
+  const int first = int(mesh->verts.size());
+  for(int i = 0; i < 8; i++) {
+    mesh->verts.push_back(Vector3f {
+      i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z});
+  }
+  // corners of each face, in order around it
+  const int faces[6][4] = {
+    {0, 2, 6, 4}, {1, 5, 7, 3}, {0, 4, 5, 1},
+    {2, 3, 7, 6}, {0, 1, 3, 2}, {4, 6, 7, 5}
+  };
+  for(const auto &f: faces) {
+    mesh->tris.push_back(Tri(first + f[0], first + f[1], first + f[2]));
+    mesh->tris.push_back(Tri(first + f[0], first + f[2], first + f[3]));
+  }
+}
+
+// |x| + |y| + |z| <= radius
+TriMesh Octahedron(float radius) {
+  TriMesh mesh;
+  for(int axis = 0; axis < 3; axis++) {
+    for(float sign: {1.0f, -1.0f}) {
+      Vector3f v = Zero_Vector3f;
+      (axis == 0 ? v.x : axis == 1 ? v.y : v.z) = sign * radius;
+      mesh.verts.push_back(v);
+    }
+  }
+  // verts 0/1 are +-X, 2/3 are +-Y, 4/5 are +-Z
+  for(int x = 0; x < 2; x++) {
+    for(int y = 2; y < 4; y++) {
+      for(int z = 4; z < 6; z++)
+        mesh.tris.push_back(Tri(x, y, z));
+    }
+  }
+  return mesh;
+}
+
+} // namespace
+
+TEST_CASE("Voxelize boxes") {
+  // the triangles' diagonals run exactly through rows of voxel centers, so
+  // this also checks that a ray through a shared edge crosses it once
+  TriMesh mesh;
+  AddBox(&mesh, Vector3f {0, 0, 0}, Vector3f {4, 4, 4});
+  AddBox(&mesh, Vector3f {6, 0, 0}, Vector3f {10, 2, 2});
+
+  BoolVoxelVolume v = Voxelize(mesh, 10);
+  REQUIRE(v.XSize() == 10);
+  REQUIRE(v.YSize() == 4);
+  REQUIRE(v.ZSize() == 4);
+  REQUIRE(v.VoxelXSize() == Approx(1));
+  REQUIRE(v.MaxBound().z == Approx(4));
+  for(int z = 0; z < 4; z++) {
+    for(int y = 0; y < 4; y++) {
+      for(int x = 0; x < 10; x++) {
+        bool inside = x < 4 || (x >= 6 && y < 2 && z < 2);
+        REQUIRE(v.Get(x,y,z) == inside);
+      }
+    }
+  }
+
+  // winding doesn't matter
+  for(Tri &tri: mesh.tris)
+    std::swap(tri.vert_idxs[1], tri.vert_idxs[2]);
+  REQUIRE(Voxelize(mesh, 10).GetVoxels() == v.GetVoxels());
+
+  // a box in a box is a hollow box
+  AddBox(&mesh, Vector3f {1, 1, 1}, Vector3f {3, 3, 3});
+  BoolVoxelVolume hollow = Voxelize(mesh, 10);
+  REQUIRE(!hollow.Get(1, 1, 1));
+  REQUIRE(!hollow.Get(2, 2, 2));
+  REQUIRE(hollow.Get(0, 1, 1));
+  REQUIRE(hollow.Get(3, 2, 2));
+}
+
+TEST_CASE("Voxelize octahedron") {
+  // Voxel centers are never on the surface, but rays along X pass exactly
+  // through the silhouette edges, where front and back faces meet.
+  for(int resolution: {20, 37, 64, 130}) {
+    BoolVoxelVolume v = Voxelize(Octahedron(1), resolution);
+    REQUIRE(v.XSize() == resolution);
+    REQUIRE(v.YSize() == resolution);
+    REQUIRE(v.ZSize() == resolution);
+    for(int z = 0; z < resolution; z++) {
+      for(int y = 0; y < resolution; y++) {
+        for(int x = 0; x < resolution; x++) {
+          const Vector3f c = v.CenterOf(x,y,z);
+          const float r = std::abs(c.x) + std::abs(c.y) + std::abs(c.z);
+          if(std::abs(r - 1) > 1e-4f)
+            REQUIRE(v.Get(x,y,z) == (r < 1));
+        }
+      }
+    }
+  }
+}